@@ -0,0 +1,189 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "alloc_stats.hh"
+
+// ---------------------------------------------------------------------------------------------- //
+
+namespace /* anonymous */
+{
+std::atomic<std::size_t> allocations{0};
+std::atomic<std::size_t> allocated_bytes{0};
+
+void*
+allocate(std::size_t size) noexcept
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+  return std::malloc(size == 0 ? 1 : size); // NOLINT(*-no-malloc,*-owning-memory)
+}
+
+void*
+allocate(std::size_t size, std::align_val_t alignment) noexcept
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+  // The size of std::aligned_alloc() must be a multiple of the alignment.
+  const auto align = static_cast<std::size_t>(alignment);
+  const auto rounded = (size + align - 1) / align * align;
+  return std::aligned_alloc(align, rounded == 0 ? align : rounded); // NOLINT(*-owning-memory)
+}
+
+void*
+throw_if_null(void* ptr)
+{
+  if (ptr == nullptr)
+  {
+    throw std::bad_alloc{};
+  }
+  return ptr;
+}
+
+void
+deallocate(void* ptr) noexcept
+{
+  std::free(ptr); // NOLINT(*-no-malloc,*-owning-memory)
+}
+} // namespace
+
+// ---------------------------------------------------------------------------------------------- //
+
+std::size_t
+nb_allocations() noexcept
+{
+  return allocations.load();
+}
+
+std::size_t
+nb_allocated_bytes() noexcept
+{
+  return allocated_bytes.load();
+}
+
+// ---------------------------------------------------------------------------------------------- //
+
+// All forms are replaced, so that memory is always allocated with std::malloc() or
+// std::aligned_alloc(), and freed with std::free().
+
+void*
+operator new(std::size_t size)
+{
+  return throw_if_null(allocate(size));
+}
+
+void*
+operator new[](std::size_t size)
+{
+  return throw_if_null(allocate(size));
+}
+
+void*
+operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+  return allocate(size);
+}
+
+void*
+operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+  return allocate(size);
+}
+
+void*
+operator new(std::size_t size, std::align_val_t alignment)
+{
+  return throw_if_null(allocate(size, alignment));
+}
+
+void*
+operator new[](std::size_t size, std::align_val_t alignment)
+{
+  return throw_if_null(allocate(size, alignment));
+}
+
+void*
+operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+  return allocate(size, alignment);
+}
+
+void*
+operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+  return allocate(size, alignment);
+}
+
+void
+operator delete(void* ptr) noexcept
+{
+  deallocate(ptr);
+}
+
+void
+operator delete[](void* ptr) noexcept
+{
+  deallocate(ptr);
+}
+
+void
+operator delete(void* ptr, std::size_t) noexcept
+{
+  deallocate(ptr);
+}
+
+void
+operator delete[](void* ptr, std::size_t) noexcept
+{
+  deallocate(ptr);
+}
+
+void
+operator delete(void* ptr, const std::nothrow_t&) noexcept
+{
+  deallocate(ptr);
+}
+
+void
+operator delete[](void* ptr, const std::nothrow_t&) noexcept
+{
+  deallocate(ptr);
+}
+
+void
+operator delete(void* ptr, std::align_val_t) noexcept
+{
+  deallocate(ptr);
+}
+
+void
+operator delete[](void* ptr, std::align_val_t) noexcept
+{
+  deallocate(ptr);
+}
+
+void
+operator delete(void* ptr, std::size_t, std::align_val_t) noexcept
+{
+  deallocate(ptr);
+}
+
+void
+operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept
+{
+  deallocate(ptr);
+}
+
+void
+operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept
+{
+  deallocate(ptr);
+}
+
+void
+operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept
+{
+  deallocate(ptr);
+}
+
+// ---------------------------------------------------------------------------------------------- //
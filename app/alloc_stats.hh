@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+
+// ---------------------------------------------------------------------------------------------- //
+
+// Allocations of the whole process, counted by the replacements of the global operators new of
+// alloc_stats.cc. They are only linked in the clox_alloc_stats target, so that the interpreter
+// itself doesn't pay for counting.
+
+[[nodiscard]] std::size_t
+nb_allocations() noexcept;
+
+[[nodiscard]] std::size_t
+nb_allocated_bytes() noexcept;
+
+// ---------------------------------------------------------------------------------------------- //
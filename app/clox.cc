@@ -1,42 +1,57 @@
+#include <fstream>
 #include <iostream>
 #include <memory>
+#include <optional>
 #include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
 
+#include "clox/cache.hh"
 #include "clox/compile.hh"
+#include "clox/line_index.hh"
+#include "clox/mapped_file.hh"
 #include "clox/scanner.hh"
+#include "clox/trace.hh"
 #include "clox/vm.hh"
 
 #include "version.hh"
 
+#ifdef CLOX_ALLOC_STATS
+#include "alloc_stats.hh"
+#endif
+
 // ---------------------------------------------------------------------------------------------- //
 
 namespace /* anonymous */
 {
-std::string
-read_file(const std::string& file_path)
+// Peak resident set size of this process, as reported by Linux. Unlike the one returned by
+// getrusage(), it doesn't include the memory of the parent before exec().
+std::optional<std::string>
+peak_rss()
 {
-  auto file_stream = std::ifstream{file_path};
-  auto file_content = std::string{};
-
-  file_stream.seekg(0, std::ios::end);
-  file_content.reserve(file_stream.tellg());
-  file_stream.seekg(0, std::ios::beg);
-
-  file_content.assign(std::istreambuf_iterator<char>{file_stream},
-                      std::istreambuf_iterator<char>{});
-
-  return file_content;
+  auto status = std::ifstream{"/proc/self/status"};
+  for (auto line = std::string{}; std::getline(status, line);)
+  {
+    if (line.starts_with("VmHWM:"))
+    {
+      const auto value = line.find_first_not_of(" \t", line.find(':') + 1);
+      return value == std::string::npos ? line : line.substr(value);
+    }
+  }
+  return std::nullopt;
 }
 
 std::shared_ptr<clox::Memory>
-interpret(const std::string& content, clox::VM& vm, std::shared_ptr<clox::Memory> memory)
+interpret(clox::Scanner&& scanner, clox::VM& vm, std::shared_ptr<clox::Memory> memory)
 {
   using namespace clox;
 
   auto r = boost::leaf::try_handle_some(
     [&]() -> boost::leaf::result<std::shared_ptr<Memory>>
     {
-      BOOST_LEAF_AUTO(chunk, Compile{Scanner{content}}(std::move(memory)));
+      BOOST_LEAF_AUTO(chunk, Compile{std::move(scanner)}(std::move(memory)));
       const auto result = vm(std::move(chunk));
 
       return result.memory;
@@ -50,15 +65,118 @@ interpret(const std::string& content, clox::VM& vm, std::shared_ptr<clox::Memory
   return r.value();
 }
 
+// Large sources are scanned on all cores.
+clox::Scanner
+scan(std::string_view source)
+{
+  return clox::Scanner::parallel(source, std::thread::hardware_concurrency());
+}
+
+// Run the chunk cached for the source at `path` if it's up to date, so that neither the scanner
+// nor the compiler run. Otherwise, compile the source and cache the result for the next runs.
 std::shared_ptr<clox::Memory>
-interpret(const std::string& content)
+interpret_file(const std::string& path, bool use_cache, clox::VM& vm)
+{
+  using namespace clox;
+
+  // The source is mapped rather than copied: the scanner reads it in place.
+  const auto file = MappedFile{path};
+  const auto content = file.str();
+  if (not use_cache)
+  {
+    return interpret(scan(content), vm, std::make_shared<Memory>());
+  }
+
+  const auto key = cache_key(content);
+  if (auto cached = load_cache(cache_path(path), key))
+  {
+    // Lines are only computed if they are reported.
+    cached->code->set_line_index(std::make_shared<LineIndex>(content));
+    return vm(std::move(*cached)).memory;
+  }
+
+  auto r = boost::leaf::try_handle_some(
+    [&]() -> boost::leaf::result<std::shared_ptr<Memory>>
+    {
+      BOOST_LEAF_AUTO(chunk, Compile{scan(content)}(std::make_shared<Memory>()));
+      try
+      {
+        save_cache(cache_path(path), chunk, key);
+      }
+      catch (const std::exception&)
+      {
+        // The cache is an optimization: the script still runs where it can't be written.
+      }
+      return vm(std::move(chunk)).memory;
+    },
+    [](std::shared_ptr<Memory> new_memory, const std::string& error_msg)
+    {
+      std::cerr << error_msg << '\n';
+      return new_memory;
+    });
+
+  return r.value();
+}
+
+// A scanner of the file at `path` as it's read, so that it's never in memory as a whole.
+clox::Scanner
+stream_scanner(const std::string& path)
 {
-  auto vm = clox::VM{clox::VM::opt_disassemble::yes};
-  auto code_context = std::make_shared<clox::Memory>();
-  return interpret(content, vm, std::move(code_context));
+  auto file = std::make_shared<std::ifstream>(path, std::ios::binary);
+  if (not *file)
+  {
+    throw std::runtime_error{"Could not open " + path};
+  }
+  return clox::Scanner{[file](std::span<char> buffer) -> std::size_t
+                       {
+                         file->read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+                         return static_cast<std::size_t>(file->gcount());
+                       }};
 }
 
-void
+// Scan the source at `path` as it's read. It's not cached, as its key would require a first pass
+// over it.
+std::shared_ptr<clox::Memory>
+stream_file(const std::string& path, clox::VM& vm)
+{
+  return interpret(stream_scanner(path), vm, std::make_shared<clox::Memory>());
+}
+
+// Print the instructions recorded in the trace at `trace_path` while running the script at `path`.
+// The script is compiled again, as when it was traced, and must not have changed since.
+std::shared_ptr<clox::Memory>
+decode_trace_file(const std::string& trace_path, const std::string& path)
+{
+  using namespace clox;
+
+  auto trace_file = std::ifstream{trace_path, std::ios::binary};
+  if (not trace_file)
+  {
+    throw std::runtime_error{"Could not open " + trace_path};
+  }
+  const auto trace = read_trace(trace_file);
+
+  auto file = std::optional<MappedFile>{};
+  auto scanner = trace.streamed == Tracer::opt_streamed::yes ? stream_scanner(path)
+                                                               : scan(file.emplace(path).str());
+
+  auto r = boost::leaf::try_handle_some(
+    [&]() -> boost::leaf::result<std::shared_ptr<Memory>>
+    {
+      BOOST_LEAF_AUTO(chunk, Compile{std::move(scanner)}(std::make_shared<Memory>()));
+      decode_trace(trace, chunk, std::cout);
+      return chunk.memory;
+    },
+    [](std::shared_ptr<Memory> new_memory, const std::string& error_msg)
+    {
+      std::cerr << error_msg << '\n';
+      return new_memory;
+    });
+
+  return r.value();
+}
+
+std::shared_ptr<clox::Memory>
 repl()
 {
   auto vm = clox::VM{clox::VM::opt_disassemble::no};
@@ -67,10 +185,11 @@ repl()
   std::cout << "> ";
   for (auto line = std::string{}; std::getline(std::cin, line);)
   {
-    memory = interpret(line, vm, std::move(memory));
+    memory = interpret(clox::Scanner{line}, vm, std::move(memory));
     std::cout << "> ";
   }
   std::cout << "Good bye!\n";
+  return memory;
 }
 } // namespace
 
@@ -82,25 +201,110 @@ main(int argc, char** _argv)
   using namespace clox;
   try
   {
-    const auto argv = std::span{_argv, static_cast<std::size_t>(argc)};
+    auto argv = std::span{_argv, static_cast<std::size_t>(argc)}.subspan(1);
 
-    std::cout << "Clox interpreter (v" << CLOX_VERSION << ")\n";
+    auto gc_stats = false;
+    auto alloc_stats = false;
+    auto use_cache = true;
+    auto stream = false;
+    auto disassemble = VM::opt_disassemble::no;
+    auto trace_path = std::optional<std::string>{};
+    auto decode_path = std::optional<std::string>{};
+    for (; not argv.empty() and std::string_view{argv.front()}.starts_with("--");
+         argv = argv.subspan(1))
+    {
+      if (std::string_view{argv.front()} == "--gc-stats")
+      {
+        gc_stats = true;
+      }
+      else if (std::string_view{argv.front()} == "--alloc-stats")
+      {
+        alloc_stats = true;
+      }
+      else if (std::string_view{argv.front()} == "--no-cache")
+      {
+        use_cache = false;
+      }
+      else if (std::string_view{argv.front()} == "--stream")
+      {
+        stream = true;
+      }
+      else if (std::string_view{argv.front()} == "--disassemble")
+      {
+        disassemble = VM::opt_disassemble::yes;
+      }
+      else if (std::string_view{argv.front()} == "--trace" and argv.size() > 1)
+      {
+        argv = argv.subspan(1);
+        trace_path = argv.front();
+      }
+      else if (std::string_view{argv.front()} == "--decode-trace" and argv.size() > 1)
+      {
+        argv = argv.subspan(1);
+        decode_path = argv.front();
+      }
+      else
+      {
+        std::cerr << "Unknown option " << argv.front() << '\n';
+        return -1;
+      }
+    }
 
-    if (argc == 1)
+    // Flushed before the VM writes to the standard output directly.
+    std::cout << "Clox interpreter (v" << CLOX_VERSION << ")\n" << std::flush;
+
+    auto memory = std::shared_ptr<Memory>{};
+    if (argv.empty() and not trace_path and not decode_path)
+    {
+      memory = repl();
+    }
+    else if (argv.size() == 1 and decode_path)
     {
-      repl();
+      memory = decode_trace_file(*decode_path, argv[0]);
     }
-    else if (argc == 2)
+    else if (argv.size() == 1)
     {
-      const auto file_content = read_file(argv[1]);
-      interpret(file_content);
+      auto vm = VM{disassemble};
+      // Declared before the tracer, which writes to it until it's destroyed.
+      auto trace = std::ofstream{};
+      auto tracer = std::optional<Tracer>{};
+      if (trace_path)
+      {
+        trace.open(*trace_path, std::ios::binary);
+        if (not trace)
+        {
+          throw std::runtime_error{"Could not open " + *trace_path};
+        }
+        vm.set_tracer(
+          &tracer.emplace(trace, stream ? Tracer::opt_streamed::yes : Tracer::opt_streamed::no));
+      }
+      memory = stream ? stream_file(argv[0], vm) : interpret_file(argv[0], use_cache, vm);
     }
     else
     {
-      std::cerr << "Usage: clox [path]\n";
+      std::cerr << "Usage: clox [--gc-stats] [--alloc-stats] [--no-cache] [--stream] "
+                   "[--disassemble] [--trace <trace>] [path]\n"
+                   "       clox --decode-trace <trace> <path>\n";
       return -1;
     }
 
+    if (gc_stats and memory)
+    {
+      std::cerr << "GC: " << memory->gc_stats() << '\n';
+    }
+    if (alloc_stats)
+    {
+      // Allocations are only counted by the clox_alloc_stats build.
+#ifdef CLOX_ALLOC_STATS
+      std::cerr << "Allocations: " << nb_allocations() << " (" << nb_allocated_bytes()
+                << " bytes)\n";
+#endif
+      if (const auto rss = peak_rss())
+      {
+        std::cerr << "Peak RSS: " << *rss << '\n';
+      }
+    }
+
     return 0;
   }
   catch (const std::exception& e)
@@ -0,0 +1,100 @@
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include "clox/compile.hh"
+#include "clox/mapped_file.hh"
+#include "clox/profile.hh"
+#include "clox/scanner.hh"
+
+// ---------------------------------------------------------------------------------------------- //
+
+namespace /* anonymous */
+{
+constexpr auto nb_reported = std::size_t{20};
+
+// Return false if the file could not be compiled.
+bool
+record(const std::string& file_path, clox::Compile::opt_optimize optimize,
+       clox::OpcodeProfile& profile)
+{
+  using namespace clox;
+
+  // The scanner refers to the source, which must outlive it.
+  auto source = std::optional<MappedFile>{};
+  try
+  {
+    source.emplace(file_path);
+  }
+  catch (const std::system_error& e)
+  {
+    std::cerr << e.what() << '\n';
+    return false;
+  }
+
+  auto r = boost::leaf::try_handle_some(
+    [&]() -> boost::leaf::result<bool>
+    {
+      auto compile = Compile{Scanner{source->str()}, optimize};
+      BOOST_LEAF_AUTO(chunk, compile(std::make_shared<Memory>()));
+      profile.record(*chunk.code);
+      return true;
+    },
+    [&](std::shared_ptr<Memory>, const std::string& error_msg)
+    {
+      std::cerr << file_path << ": " << error_msg << '\n';
+      return false;
+    });
+
+  return r.value();
+}
+} // namespace
+
+// ---------------------------------------------------------------------------------------------- //
+
+// Report the most frequent sequences of opcodes in a set of programs.
+int
+main(int argc, char** _argv)
+{
+  using namespace clox;
+  try
+  {
+    const auto argv = std::span{_argv, static_cast<std::size_t>(argc)}.subspan(1);
+
+    auto optimize = Compile::opt_optimize::yes;
+    auto profile = OpcodeProfile{};
+    auto nb_files = std::size_t{0};
+
+    for (const auto* arg : argv)
+    {
+      if (std::string_view{arg} == "--no-peephole")
+      {
+        optimize = Compile::opt_optimize::no;
+      }
+      else
+      {
+        nb_files += record(arg, optimize, profile) ? 1 : 0;
+      }
+    }
+
+    if (nb_files == 0)
+    {
+      std::cerr << "Usage: clox_profile [--no-peephole] path...\n";
+      return -1;
+    }
+
+    profile.report(std::cout, nb_reported);
+    return 0;
+  }
+  catch (const std::exception& e)
+  {
+    std::cerr << e.what() << '\n';
+    return -1;
+  }
+}
+
+// ---------------------------------------------------------------------------------------------- //
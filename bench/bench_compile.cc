@@ -0,0 +1,72 @@
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <benchmark/benchmark.h>
+#include <fmt/core.h>
+
+#include "clox/compile.hh"
+
+// NOLINTBEGIN(readability-magic-numbers)
+
+namespace /* anonymous */ {
+
+// A generated script of `nb_lines` lines: each line uses several global variables, numbers and
+// string literals, as scripts written by code generators do.
+std::string
+generated_program(std::int64_t nb_lines)
+{
+  auto program = std::string{};
+  for (auto i = std::int64_t{0}; i < nb_lines; ++i)
+  {
+    switch (i % 3)
+    {
+      case 0:
+        program += fmt::format("var generated_variable_{} = {}.5 * 12.25;\n", i, i);
+        break;
+      case 1:
+        // Also use a variable defined a few lines before.
+        program += fmt::format("generated_variable_{0} = generated_variable_{0} + "
+                               "generated_variable_{1} / 1024.0625;\n",
+                               i - 1,
+                               i > 30 ? i - 31 : i - 1);
+        break;
+      default:
+        program += fmt::format("print \"generated string literal number {}\";\n", i);
+        break;
+    }
+  }
+  return program;
+}
+
+// Scan and compile a whole script, without executing it.
+void
+bench_compile(benchmark::State& state)
+{
+  using namespace clox;
+
+  const auto program = generated_program(state.range(0));
+
+  for ([[maybe_unused]] auto _ : state)
+  {
+    auto result = Compile{Scanner{program}}(std::make_shared<Memory>());
+    if (not result)
+    {
+      state.SkipWithError("Compilation failed");
+      return;
+    }
+    benchmark::DoNotOptimize(result);
+  }
+
+  state.SetBytesProcessed(state.iterations() * static_cast<std::int64_t>(program.size()));
+}
+
+} // namespace
+
+BENCHMARK(bench_compile)
+  ->Name("compile/generated")
+  ->RangeMultiplier(10)
+  ->Range(100, 100'000)
+  ->Unit(benchmark::kMillisecond);
+
+// NOLINTEND(readability-magic-numbers)
@@ -0,0 +1,176 @@
+#include <array>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+#include <benchmark/benchmark.h>
+#include <fmt/core.h>
+#include <magic_enum.hpp>
+
+#include "clox/compile.hh"
+#include "clox/trace.hh"
+#include "clox/verify.hh"
+#include "clox/vm.hh"
+
+// NOLINTBEGIN(readability-magic-numbers)
+
+namespace /* anonymous */ {
+
+// As there are no loops yet in clox, an arithmetic-heavy workload is a long sequence of statements.
+std::string
+arithmetic_program(std::int64_t nb_statements)
+{
+  auto program = std::string{"var a = 1; var b = 2; var c = 3;\n"};
+  for (auto i = std::int64_t{0}; i < nb_statements; ++i)
+  {
+    program += fmt::format("a = (a + b * c - {}) / c;\n", i % 10);
+    program += "b = -b + 2 * c;\n";
+    program += "a < b == !(c >= 2);\n";
+  }
+  return program;
+}
+
+// With `traced`, executed instructions are recorded to a tracer which discards them, to measure the
+// overhead of recording.
+void
+bench_dispatch(benchmark::State& state, clox::VM::opt_dispatch dispatch, bool traced)
+{
+  using namespace clox;
+
+  const auto program = arithmetic_program(state.range(0));
+  auto compiled = Compile{Scanner{program}}(std::make_shared<Memory>());
+  if (not compiled)
+  {
+    state.SkipWithError("Compilation failed");
+    return;
+  }
+
+  const auto chunk = compiled.value();
+  auto vm = VM{VM::opt_disassemble::no, dispatch};
+  auto discard = std::ostream{nullptr};
+  auto tracer = std::optional<Tracer>{};
+  if (traced)
+  {
+    vm.set_tracer(&tracer.emplace(discard));
+  }
+
+  for ([[maybe_unused]] auto _ : state)
+  {
+    auto result = vm(Chunk{chunk});
+    benchmark::DoNotOptimize(result);
+  }
+
+  state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * chunk.code->size()));
+}
+
+// ---------------------------------------------------------------------------------------------- //
+
+// Instructions whose cost is measured by running them many times in a row. Each body leaves the
+// stack as it found it, with a number on top, and a global variable `a` is defined.
+struct OpcodeWorkload
+{
+  std::string_view name;
+  void (*add_body)(clox::Code&, clox::detail::ConstantIndex, clox::detail::GlobalVariableIndex);
+};
+
+constexpr auto opcode_workloads = std::to_array<OpcodeWorkload>({
+  {"constant_pop",
+   [](auto& code, auto one, auto)
+   {
+     code.add_opcode(clox::OpConstant{one});
+     code.add_opcode(clox::OpPop<1>{});
+   }},
+  {"add",
+   [](auto& code, auto one, auto)
+   {
+     code.add_opcode(clox::OpConstant{one});
+     code.add_opcode(clox::OpAdd{});
+   }},
+  {"add_constant", [](auto& code, auto one, auto) { code.add_opcode(clox::OpAddConstant{one}); }},
+  {"add_global", [](auto& code, auto, auto a) { code.add_opcode(clox::OpAddGlobal{a}); }},
+  {"negate", [](auto& code, auto, auto) { code.add_opcode(clox::OpNegate{}); }},
+  {"less",
+   [](auto& code, auto one, auto)
+   {
+     code.add_opcode(clox::OpConstant{one});
+     code.add_opcode(clox::OpLess{});
+     code.add_opcode(clox::OpPop<1>{});
+     code.add_opcode(clox::OpConstant{one});
+   }},
+  {"get_global_pop",
+   [](auto& code, auto, auto a)
+   {
+     code.add_opcode(clox::OpGetGlobalVar{a});
+     code.add_opcode(clox::OpPop<1>{});
+   }},
+  {"set_global", [](auto& code, auto, auto a) { code.add_opcode(clox::OpSetGlobal{a}); }},
+});
+
+// Run the body of `workload` state.range(0) times.
+void
+bench_opcode(benchmark::State& state, OpcodeWorkload workload)
+{
+  using namespace clox;
+
+  auto chunk = Chunk{std::make_shared<Code>(), std::make_shared<Memory>()};
+  auto& code = *chunk.code;
+  const auto one = code.add_constant(1.0);
+  const auto a = chunk.memory->maybe_add_global_variable("a");
+  code.add_opcode(OpConstant{one});
+  code.add_opcode(OpDefineGlobalVar{a});
+  code.add_opcode(OpConstant{one});
+  for (auto i = std::int64_t{0}; i < state.range(0); ++i)
+  {
+    workload.add_body(code, one, a);
+  }
+  code.add_opcode(OpPop<1>{});
+  code.add_opcode(OpReturn{});
+
+  auto verified = verify(std::move(chunk));
+  if (not verified)
+  {
+    state.SkipWithError("Invalid bytecode");
+    return;
+  }
+
+  const auto checked = verified.value();
+  auto vm = VM{};
+  for ([[maybe_unused]] auto _ : state)
+  {
+    auto result = vm(Chunk{checked});
+    benchmark::DoNotOptimize(result);
+  }
+
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// ---------------------------------------------------------------------------------------------- //
+
+const auto registered = []
+{
+  for (const auto dispatch : magic_enum::enum_values<clox::VM::opt_dispatch>())
+  {
+    if (clox::VM::supports(dispatch))
+    {
+      for (const auto traced : {false, true})
+      {
+        const auto name = fmt::format(
+          "dispatch/{}{}", magic_enum::enum_name(dispatch), traced ? "/traced" : "");
+        benchmark::RegisterBenchmark(name.c_str(), bench_dispatch, dispatch, traced)
+          ->RangeMultiplier(10)
+          ->Range(10, 10'000);
+      }
+    }
+  }
+  for (const auto& workload : opcode_workloads)
+  {
+    const auto name = fmt::format("dispatch/opcode/{}", workload.name);
+    benchmark::RegisterBenchmark(name.c_str(), bench_opcode, workload)->Arg(10'000);
+  }
+  return true;
+}();
+
+} // namespace
+
+// NOLINTEND(readability-magic-numbers)
@@ -0,0 +1,74 @@
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <benchmark/benchmark.h>
+#include <fcntl.h>
+#include <fmt/core.h>
+#include <unistd.h>
+
+#include "clox/compile.hh"
+#include "clox/output.hh"
+#include "clox/vm.hh"
+
+// NOLINTBEGIN(readability-magic-numbers)
+
+namespace /* anonymous */ {
+
+// A batch script which mostly prints numbers, booleans and strings.
+std::string
+print_program(std::int64_t nb_statements)
+{
+  auto program = std::string{"var a = 1; var s = \"value\";\n"};
+  for (auto i = std::int64_t{0}; i < nb_statements; ++i)
+  {
+    program += fmt::format("print a * {}.25;\n", i);
+    program += "print a / 3;\n";
+    program += "print a < 2;\n";
+    program += "print s;\n";
+  }
+  return program;
+}
+
+// Print to /dev/null, so that only formatting and writing are measured.
+void
+bench_print(benchmark::State& state)
+{
+  using namespace clox;
+
+  const auto program = print_program(state.range(0));
+  auto compiled = Compile{Scanner{program}}(std::make_shared<Memory>());
+  if (not compiled)
+  {
+    state.SkipWithError("Compilation failed");
+    return;
+  }
+
+  const auto fd = ::open("/dev/null", O_WRONLY | O_CLOEXEC); // NOLINT(*-vararg)
+  if (fd < 0)
+  {
+    state.SkipWithError("Could not open /dev/null");
+    return;
+  }
+
+  {
+    const auto chunk = compiled.value();
+    auto output = Output{fd};
+    auto vm = VM{};
+    vm.set_output(output);
+
+    for ([[maybe_unused]] auto _ : state)
+    {
+      auto result = vm(Chunk{chunk});
+      benchmark::DoNotOptimize(result);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0) * 4);
+  }
+  ::close(fd);
+}
+
+} // namespace
+
+BENCHMARK(bench_print)->Name("output/print")->Arg(10'000);
+
+// NOLINTEND(readability-magic-numbers)
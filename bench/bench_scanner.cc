@@ -0,0 +1,118 @@
+#include <algorithm>
+#include <cstddef>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include <benchmark/benchmark.h>
+#include <fmt/core.h>
+
+#include "clox/scanner.hh"
+
+// NOLINTBEGIN(readability-magic-numbers)
+
+namespace /* anonymous */ {
+
+// About `nb_lines` lines of identifiers, keywords, numbers, strings, comments and indentation.
+std::string
+scanner_program(std::int64_t nb_lines)
+{
+  auto program = std::string{};
+  for (auto i = std::int64_t{0}; i < nb_lines / 4; ++i)
+  {
+    program += fmt::format("// Definition of the variable number {}, with its initial value.\n", i);
+    program += fmt::format("var some_variable_{} = {}.25 * (other_variable - 12) / 3;\n", i, i);
+    program += fmt::format("        if (some_variable_{} >= 10 and true) print \"a string "
+                           "literal which is somewhat long\";\n",
+                           i);
+    program +=
+      fmt::format("    some_variable_{0} = some_variable_{0} + \"suffix\"; // Comment\n", i);
+  }
+  return program;
+}
+
+std::int64_t
+scan(clox::Scanner& scanner)
+{
+  auto nb_tokens = std::int64_t{0};
+  while (scanner.next_token().type != clox::TokenType::eof)
+  {
+    ++nb_tokens;
+  }
+  return nb_tokens;
+}
+
+// Scan a source held in memory.
+void
+bench_scanner(benchmark::State& state)
+{
+  using namespace clox;
+
+  const auto program = scanner_program(state.range(0));
+  auto nb_tokens = std::int64_t{0};
+
+  for ([[maybe_unused]] auto _ : state)
+  {
+    auto scanner = Scanner{program};
+    nb_tokens = scan(scanner);
+    benchmark::DoNotOptimize(nb_tokens);
+  }
+
+  state.SetBytesProcessed(state.iterations() * static_cast<std::int64_t>(program.size()));
+  state.counters["tokens"] = static_cast<double>(nb_tokens);
+}
+
+// Scan a source read by chunks of the default size.
+void
+bench_scanner_stream(benchmark::State& state)
+{
+  using namespace clox;
+
+  const auto program = scanner_program(state.range(0));
+
+  for ([[maybe_unused]] auto _ : state)
+  {
+    auto source = std::string_view{program};
+    auto scanner = Scanner{[&source](std::span<char> buffer)
+                           {
+                             const auto size = std::min(source.size(), buffer.size());
+                             std::copy_n(source.begin(), size, buffer.begin());
+                             source.remove_prefix(size);
+                             return size;
+                           }};
+    benchmark::DoNotOptimize(scan(scanner));
+  }
+
+  state.SetBytesProcessed(state.iterations() * static_cast<std::int64_t>(program.size()));
+}
+
+// Scan a large source on the given number of threads, then consume the tokens as the compiler does.
+void
+bench_scanner_parallel(benchmark::State& state)
+{
+  using namespace clox;
+
+  const auto program = scanner_program(400'000);
+  const auto nb_threads = static_cast<std::size_t>(state.range(0));
+
+  for ([[maybe_unused]] auto _ : state)
+  {
+    auto scanner = Scanner::parallel(program, nb_threads, 64 * 1024);
+    benchmark::DoNotOptimize(scan(scanner));
+  }
+
+  state.SetBytesProcessed(state.iterations() * static_cast<std::int64_t>(program.size()));
+}
+
+BENCHMARK(bench_scanner)->Name("scanner/memory")->Arg(10'000)->Arg(100'000);
+BENCHMARK(bench_scanner_stream)->Name("scanner/stream")->Arg(100'000);
+BENCHMARK(bench_scanner_parallel)
+  ->Name("scanner/parallel")
+  ->RangeMultiplier(2)
+  ->Range(1, 8)
+  ->UseRealTime()
+  ->Unit(benchmark::kMillisecond);
+
+} // namespace
+
+// NOLINTEND(readability-magic-numbers)
@@ -0,0 +1,110 @@
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "clox/memory.hh"
+
+// NOLINTBEGIN(readability-magic-numbers)
+
+namespace /* anonymous */ {
+
+// Intern `nb_strings` distinct strings, then look each of them up again.
+void
+bench_intern(benchmark::State& state)
+{
+  using namespace clox;
+
+  const auto nb_strings = state.range(0);
+  auto stats = InternTable::Stats{};
+
+  for ([[maybe_unused]] auto _ : state)
+  {
+    auto memory = Memory{};
+    for (auto i = std::int64_t{0}; i < nb_strings; ++i)
+    {
+      benchmark::DoNotOptimize(memory.make_string("string #" + std::to_string(i)));
+    }
+    for (auto i = std::int64_t{0}; i < nb_strings; ++i)
+    {
+      benchmark::DoNotOptimize(memory.make_string("string #" + std::to_string(i)));
+    }
+
+    state.PauseTiming();
+    stats = memory.interned_strings_stats();
+    state.ResumeTiming();
+  }
+
+  state.SetItemsProcessed(state.iterations() * nb_strings * 2);
+  state.counters["load_factor"] = stats.load_factor;
+  state.counters["max_chain"] = static_cast<double>(stats.max_chain_length);
+  state.counters["mean_chain"] = stats.mean_chain_length;
+}
+
+std::vector<std::string>
+distinct_strings(std::int64_t nb_strings)
+{
+  auto strings = std::vector<std::string>{};
+  for (auto i = std::int64_t{0}; i < nb_strings; ++i)
+  {
+    strings.push_back("string #" + std::to_string(i));
+  }
+  return strings;
+}
+
+// Look up strings which are all interned already.
+void
+bench_make_string_hit(benchmark::State& state)
+{
+  using namespace clox;
+
+  const auto strings = distinct_strings(state.range(0));
+  auto memory = Memory{};
+  for (const auto& str : strings)
+  {
+    benchmark::DoNotOptimize(memory.make_string(str));
+  }
+
+  for ([[maybe_unused]] auto _ : state)
+  {
+    for (const auto& str : strings)
+    {
+      benchmark::DoNotOptimize(memory.make_string(str));
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Intern strings which are all new.
+void
+bench_make_string_miss(benchmark::State& state)
+{
+  using namespace clox;
+
+  const auto strings = distinct_strings(state.range(0));
+
+  for ([[maybe_unused]] auto _ : state)
+  {
+    state.PauseTiming();
+    auto memory = Memory{};
+    state.ResumeTiming();
+    for (const auto& str : strings)
+    {
+      benchmark::DoNotOptimize(memory.make_string(str));
+    }
+    state.PauseTiming();
+    memory = Memory{};
+    state.ResumeTiming();
+  }
+
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(bench_intern)->Name("strings/intern")->RangeMultiplier(10)->Range(1'000, 1'000'000);
+BENCHMARK(bench_make_string_hit)->Name("strings/make_string/hit")->Arg(100'000);
+BENCHMARK(bench_make_string_miss)->Name("strings/make_string/miss")->Arg(100'000);
+
+} // namespace
+
+// NOLINTEND(readability-magic-numbers)
@@ -0,0 +1,151 @@
+#include <cstdint>
+#include <ostream>
+#include <sstream>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "clox/detail/stack.hh"
+#include "clox/memory.hh"
+#include "clox/output.hh"
+#include "clox/value.hh"
+
+// NOLINTBEGIN(readability-magic-numbers)
+
+namespace /* anonymous */ {
+
+// Numbers with a few digits, and some which need all of them.
+std::vector<clox::Value>
+numbers(std::int64_t nb_values)
+{
+  auto values = std::vector<clox::Value>{};
+  values.reserve(static_cast<std::size_t>(nb_values));
+  for (auto i = std::int64_t{0}; i < nb_values; ++i)
+  {
+    values.emplace_back(i % 3 == 0 ? static_cast<double>(i) / 3 : static_cast<double>(i) * 0.25);
+  }
+  return values;
+}
+
+// ---------------------------------------------------------------------------------------------- //
+
+void
+bench_compare_numbers(benchmark::State& state)
+{
+  const auto values = numbers(state.range(0));
+
+  for ([[maybe_unused]] auto _ : state)
+  {
+    auto nb_less = 0;
+    for (auto i = std::size_t{1}; i < values.size(); ++i)
+    {
+      nb_less += values[i - 1] < values[i] ? 1 : 0;
+    }
+    benchmark::DoNotOptimize(nb_less);
+  }
+
+  state.SetItemsProcessed(state.iterations() * (state.range(0) - 1));
+}
+
+// Interned strings are compared by identity for equality, and by content for ordering.
+void
+bench_compare_strings(benchmark::State& state)
+{
+  using namespace clox;
+
+  auto memory = Memory{};
+  auto values = std::vector<Value>{};
+  for (auto i = std::int64_t{0}; i < state.range(0); ++i)
+  {
+    values.emplace_back(memory.make_string("a common prefix, then " + std::to_string(i % 100)));
+  }
+
+  for ([[maybe_unused]] auto _ : state)
+  {
+    auto nb_equal = 0;
+    auto nb_less = 0;
+    for (auto i = std::size_t{1}; i < values.size(); ++i)
+    {
+      nb_equal += values[i - 1] == values[i] ? 1 : 0;
+      nb_less += values[i - 1] < values[i] ? 1 : 0;
+    }
+    benchmark::DoNotOptimize(nb_equal);
+    benchmark::DoNotOptimize(nb_less);
+  }
+
+  state.SetItemsProcessed(state.iterations() * (state.range(0) - 1));
+}
+
+// ---------------------------------------------------------------------------------------------- //
+
+// Format numbers as the VM prints them.
+void
+bench_format_output(benchmark::State& state)
+{
+  const auto values = numbers(state.range(0));
+  auto discard = std::ostream{nullptr};
+  auto output = clox::Output{discard};
+
+  for ([[maybe_unused]] auto _ : state)
+  {
+    for (const auto& value : values)
+    {
+      output.print(value);
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Format numbers with operator<<.
+void
+bench_format_stream(benchmark::State& state)
+{
+  const auto values = numbers(state.range(0));
+
+  for ([[maybe_unused]] auto _ : state)
+  {
+    auto os = std::ostringstream{};
+    for (const auto& value : values)
+    {
+      os << value << '\n';
+    }
+    benchmark::DoNotOptimize(os);
+  }
+
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// ---------------------------------------------------------------------------------------------- //
+
+// Push values, then pop them all, as a sequence of instructions does.
+void
+bench_stack(benchmark::State& state)
+{
+  const auto values = numbers(state.range(0));
+  auto stack = clox::detail::Stack{values.size()};
+
+  for ([[maybe_unused]] auto _ : state)
+  {
+    for (const auto& value : values)
+    {
+      stack.push(value);
+    }
+    for (auto i = std::size_t{0}; i < values.size(); ++i)
+    {
+      benchmark::DoNotOptimize(stack.pop());
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations() * state.range(0) * 2);
+}
+
+} // namespace
+
+BENCHMARK(bench_compare_numbers)->Name("value/compare/numbers")->Arg(10'000);
+BENCHMARK(bench_compare_strings)->Name("value/compare/strings")->Arg(10'000);
+BENCHMARK(bench_format_output)->Name("value/format/output")->Arg(10'000);
+BENCHMARK(bench_format_stream)->Name("value/format/stream")->Arg(10'000);
+BENCHMARK(bench_stack)->Name("stack/push_pop")->Arg(1'000);
+
+// NOLINTEND(readability-magic-numbers)
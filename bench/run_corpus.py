@@ -0,0 +1,333 @@
+#!/usr/bin/env python3
+"""Run the clox interpreter on a corpus of generated scripts and report regressions.
+
+Each workload of the corpus is generated in small, medium and large sizes. Every script is run
+several times with `clox --no-cache`, and the runner reports:
+  - the median wall time, and its spread;
+  - the number of instructions executed by the VM, counted from a binary trace;
+  - the peak resident set size, from `clox --alloc-stats` on Linux;
+  - the number of garbage collections;
+  - the number of allocations, counted by the clox_alloc_stats build of the interpreter, if given
+    with --clox-alloc-stats.
+
+With --save, the results are written to a JSON file. With --baseline, they are compared to such a
+file: a workload regresses if it's significantly slower than in the baseline (one-sided
+Mann-Whitney U test, and a median slower by more than --threshold), if it executes more
+instructions or allocates more by more than --threshold, or if its peak RSS grows by more than
+--rss-threshold and 1 MB. The exit status is 1 if any workload regressed.
+
+    bench/run_corpus.py --clox build/app/clox --clox-alloc-stats build/app/clox_alloc_stats \
+        --save baseline.json
+    bench/run_corpus.py --clox build/app/clox --baseline baseline.json
+"""
+
+import argparse
+import json
+import math
+import os
+import re
+import statistics
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+from functools import lru_cache
+from pathlib import Path
+
+# Number of statements of each size.
+SIZES = {"small": 1_000, "medium": 10_000, "large": 100_000}
+
+# Increases of the peak RSS smaller than this are noise, whatever --rss-threshold says.
+RSS_FLOOR = 1024 * 1024
+
+
+# ------------------------------------------------------------------------------------------------ #
+# Workloads. clox has no loops yet, so long computations are unrolled.
+
+
+def arithmetic(nb_statements):
+    """Arithmetic on a few global variables, as unrolled numeric loops."""
+    lines = ["var a = 1; var b = 2; var c = 3;"]
+    for i in range(nb_statements // 3):
+        lines.append(f"a = (a + b * c - {i % 10}) / c;")
+        lines.append("b = -b + 2 * c;")
+        lines.append("a < b == !(c >= 2);")
+    lines.append("print a; print b;")
+    return lines
+
+
+def strings(nb_statements):
+    """A string built by repeated concatenations, compared and printed from time to time."""
+    lines = ['var s = ""; var piece = "piece";']
+    for i in range(nb_statements):
+        if i % 100 == 99:
+            lines.append(f'print s == "{i}";')
+        else:
+            lines.append(f's = s + piece + "{i % 10}";')
+    lines.append("print s;")
+    return lines
+
+
+def globals_heavy(nb_statements):
+    """Many global variables, each computed from others defined before."""
+    lines = ["var g0 = 1;"]
+    for i in range(1, nb_statements):
+        lines.append(f"var g{i} = g{i - 1} + g{i // 2} * 0.5;")
+    lines.append(f"print g{nb_statements - 1};")
+    return lines
+
+
+def generated(nb_statements):
+    """Code as written by a code generator: many identifiers, literals and prints."""
+    lines = []
+    for i in range(nb_statements):
+        if i % 3 == 0:
+            lines.append(f"var generated_variable_{i} = {i}.5 * 12.25;")
+        elif i % 3 == 1:
+            other = i - 31 if i > 30 else i - 1
+            lines.append(
+                f"generated_variable_{i - 1} = generated_variable_{i - 1} + "
+                f"generated_variable_{other} / 1024.0625;"
+            )
+        else:
+            lines.append(f'print "generated string literal number {i}";')
+    return lines
+
+
+def printing(nb_statements):
+    """A batch script which mostly prints numbers, booleans and strings."""
+    lines = ['var a = 1; var s = "value";']
+    for i in range(nb_statements // 4):
+        lines.append(f"print a * {i}.25;")
+        lines.append("print a / 3;")
+        lines.append("print a < 2;")
+        lines.append("print s;")
+    return lines
+
+
+WORKLOADS = {
+    "arithmetic": arithmetic,
+    "strings": strings,
+    "globals": globals_heavy,
+    "generated": generated,
+    "printing": printing,
+}
+
+
+def generate(directory, workloads, sizes):
+    """Write the scripts of the corpus to `directory`, and return their paths by name."""
+    scripts = {}
+    for workload in workloads:
+        for size in sizes:
+            path = Path(directory) / f"{workload}_{size}.clox"
+            path.write_text("\n".join(WORKLOADS[workload](SIZES[size])) + "\n")
+            scripts[f"{workload}/{size}"] = path
+    return scripts
+
+
+# ------------------------------------------------------------------------------------------------ #
+# Measures.
+
+
+def run_once(clox, script):
+    """Run `script` once, and return its wall time, peak RSS and the statistics of clox."""
+    start = time.perf_counter()
+    process = subprocess.Popen(
+        [clox, "--no-cache", "--alloc-stats", "--gc-stats", str(script)],
+        stdout=subprocess.DEVNULL,
+        stderr=subprocess.PIPE,
+    )
+    stderr = process.stderr.read().decode()
+    _, status, usage = os.wait4(process.pid, 0)
+    wall_time = time.perf_counter() - start
+    process.returncode = os.waitstatus_to_exitcode(status)
+    if process.returncode != 0:
+        sys.exit(f"clox failed on {script}:\n{stderr}")
+
+    allocations = re.search(r"Allocations: (\d+)", stderr)
+    collections = re.search(r"GC: (\d+) collections", stderr)
+    # ru_maxrss also counts the memory of this script, which the child shares until exec(); clox
+    # reports its own peak where it can. Both are in KiB.
+    peak_rss = re.search(r"Peak RSS: (\d+) kB", stderr)
+    return {
+        "wall_time": wall_time,
+        "peak_rss": (int(peak_rss.group(1)) if peak_rss else usage.ru_maxrss) * 1024,
+        "allocations": int(allocations.group(1)) if allocations else None,
+        "collections": int(collections.group(1)) if collections else None,
+    }
+
+
+def count_instructions(clox, script, directory):
+    """Number of instructions executed by the VM, from the size of a binary trace."""
+    trace = Path(directory) / "trace"
+    subprocess.run(
+        [clox, "--no-cache", "--trace", str(trace), str(script)],
+        stdout=subprocess.DEVNULL,
+        check=True,
+    )
+    # A header, then one event per instruction. The header starts with a magic string, then the
+    # format version, the size of the header and the size of an event, in the native byte order.
+    prefix = struct.Struct("=8sIII")
+    with trace.open("rb") as file:
+        header = file.read(prefix.size)
+    if len(header) < prefix.size or not header.startswith(b"CLOXT"):
+        sys.exit(f"clox wrote no trace for {script}")
+    _, _, header_size, event_size = prefix.unpack(header)
+    nb_instructions = (trace.stat().st_size - header_size) // event_size
+    trace.unlink()
+    return nb_instructions
+
+
+def measure(clox, clox_alloc_stats, script, repetitions, directory):
+    # A first run warms the page cache up.
+    run_once(clox, script)
+    runs = [run_once(clox, script) for _ in range(repetitions)]
+    # Counting slows allocations down: they are counted by a single run of another build.
+    counted = run_once(clox_alloc_stats, script) if clox_alloc_stats else None
+    return {
+        "wall_times": [run["wall_time"] for run in runs],
+        "instructions": count_instructions(clox, script, directory),
+        "peak_rss": max(run["peak_rss"] for run in runs),
+        "allocations": counted["allocations"] if counted else None,
+        "collections": runs[-1]["collections"],
+    }
+
+
+# ------------------------------------------------------------------------------------------------ #
+# Comparison.
+
+
+@lru_cache(maxsize=None)
+def nb_arrangements(u, m, n):
+    """Number of arrangements of m and n samples whose Mann-Whitney statistic is u."""
+    if u < 0:
+        return 0
+    if m == 0 or n == 0:
+        return 1 if u == 0 else 0
+    return nb_arrangements(u - n, m - 1, n) + nb_arrangements(u, m, n - 1)
+
+
+def p_slower(current, baseline):
+    """p-value of the one-sided Mann-Whitney U test that `current` is slower than `baseline`.
+
+    Exact for the small samples of the runner, ties counting for one half.
+    """
+    m, n = len(current), len(baseline)
+    u = sum(1.0 if c > b else 0.5 if c == b else 0.0 for c in current for b in baseline)
+    total = math.comb(m + n, m)
+    # Probability that U is at least as large as observed, if both samples have the same
+    # distribution.
+    return sum(nb_arrangements(k, m, n) for k in range(math.ceil(u), m * n + 1)) / total
+
+
+def regressions(name, current, baseline, threshold, rss_threshold, alpha):
+    """Reasons why `current` regressed compared to `baseline`."""
+    reasons = []
+    current_median = statistics.median(current["wall_times"])
+    baseline_median = statistics.median(baseline["wall_times"])
+    p = p_slower(current["wall_times"], baseline["wall_times"])
+    if current_median > baseline_median * (1 + threshold) and p < alpha:
+        reasons.append(
+            f"wall time {baseline_median * 1e3:.1f} -> {current_median * 1e3:.1f} ms (p={p:.3f})"
+        )
+    for metric in ("instructions", "allocations"):
+        before, after = baseline.get(metric), current.get(metric)
+        if before is not None and after is not None and after > before * (1 + threshold):
+            reasons.append(f"{metric} {before} -> {after}")
+    # The peak RSS varies by a few pages from run to run.
+    before, after = baseline["peak_rss"], current["peak_rss"]
+    if after > before * (1 + rss_threshold) and after - before > RSS_FLOOR:
+        reasons.append(f"peak RSS {before / 2**20:.1f} -> {after / 2**20:.1f} MB")
+    return [f"{name}: {reason}" for reason in reasons]
+
+
+# ------------------------------------------------------------------------------------------------ #
+
+
+def report(results, baseline):
+    header = f"{'workload':<20} {'median':>10} {'spread':>8} {'instructions':>13} {'peak RSS':>10} "
+    header += f"{'allocations':>12} {'GCs':>5}"
+    if baseline:
+        header += f" {'vs baseline':>12}"
+    print(header)
+    for name, result in results.items():
+        times = result["wall_times"]
+        median = statistics.median(times)
+        spread = (max(times) - min(times)) / median if median > 0 else 0.0
+        line = f"{name:<20} {median * 1e3:>8.1f}ms {spread:>7.1%} {result['instructions']:>13} "
+        allocations = "-" if result["allocations"] is None else result["allocations"]
+        line += f"{result['peak_rss'] / 2**20:>8.1f}MB {allocations:>12} "
+        line += f"{result['collections']:>5}"
+        if baseline and name in baseline:
+            before = statistics.median(baseline[name]["wall_times"])
+            line += f" {median / before - 1:>+12.1%}"
+        print(line)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--clox", required=True, help="path of the clox interpreter")
+    parser.add_argument(
+        "--clox-alloc-stats", help="path of the clox_alloc_stats build, to count allocations"
+    )
+    parser.add_argument("--workloads", default=",".join(WORKLOADS), help="comma-separated")
+    parser.add_argument("--sizes", default=",".join(SIZES), help="comma-separated")
+    parser.add_argument("--repetitions", type=int, default=10, help="timed runs per script")
+    parser.add_argument("--save", type=Path, help="write the results to this JSON file")
+    parser.add_argument("--baseline", type=Path, help="compare to results saved with --save")
+    parser.add_argument(
+        "--threshold", type=float, default=0.05, help="relative increase which is a regression"
+    )
+    parser.add_argument(
+        "--alpha", type=float, default=0.01, help="significance level of the wall time test"
+    )
+    parser.add_argument(
+        "--rss-threshold",
+        type=float,
+        default=0.10,
+        help="relative increase of the peak RSS which is a regression, if larger than 1 MB",
+    )
+    args = parser.parse_args()
+
+    workloads = args.workloads.split(",")
+    sizes = args.sizes.split(",")
+    for name, known in ((workloads, WORKLOADS), (sizes, SIZES)):
+        unknown = [value for value in name if value not in known]
+        if unknown:
+            sys.exit(f"Unknown workloads or sizes: {', '.join(unknown)}")
+
+    baseline = json.loads(args.baseline.read_text())["results"] if args.baseline else None
+
+    with tempfile.TemporaryDirectory(prefix="clox_corpus_") as directory:
+        scripts = generate(directory, workloads, sizes)
+        results = {
+            name: measure(args.clox, args.clox_alloc_stats, script, args.repetitions, directory)
+            for name, script in scripts.items()
+        }
+
+    report(results, baseline)
+
+    if args.save:
+        args.save.write_text(json.dumps({"clox": args.clox, "results": results}, indent=2) + "\n")
+
+    if baseline:
+        nb_baseline = min(len(result["wall_times"]) for result in baseline.values())
+        if 1 / math.comb(args.repetitions + nb_baseline, nb_baseline) >= args.alpha:
+            print(f"Too few repetitions for wall times to be significant at {args.alpha}")
+        found = [
+            reason
+            for name, result in results.items()
+            if name in baseline
+            for reason in regressions(
+                name, result, baseline[name], args.threshold, args.rss_threshold, args.alpha
+            )
+        ]
+        for reason in found:
+            print(f"REGRESSION {reason}")
+        return 1 if found else 0
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,51 @@
+#!/usr/bin/env python3
+"""Run every benchmark of clox_bench briefly, and check the JSON results it writes.
+
+    bench/smoke_bench.py build/bench/clox_bench
+"""
+
+import json
+import subprocess
+import sys
+import tempfile
+from pathlib import Path
+
+# Prefixes of the names of the benchmarks of each component.
+COMPONENTS = ("scanner/", "compile/", "strings/", "value/", "stack/", "dispatch/", "output/")
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit("Usage: smoke_bench.py <clox_bench>")
+
+    with tempfile.TemporaryDirectory(prefix="clox_bench_") as directory:
+        out = Path(directory) / "clox_bench.json"
+        subprocess.run(
+            [
+                sys.argv[1],
+                "--benchmark_min_time=0.001",
+                f"--benchmark_out={out}",
+                "--benchmark_out_format=json",
+            ],
+            stdout=subprocess.DEVNULL,
+            check=True,
+        )
+        benchmarks = json.loads(out.read_text())["benchmarks"]
+
+    errors = []
+    for benchmark in benchmarks:
+        if benchmark.get("error_occurred"):
+            errors.append(f"{benchmark['name']}: {benchmark.get('error_message')}")
+        elif benchmark["iterations"] <= 0 or benchmark["real_time"] <= 0:
+            errors.append(f"{benchmark['name']}: no measure")
+    for component in COMPONENTS:
+        if not any(benchmark["name"].startswith(component) for benchmark in benchmarks):
+            errors.append(f"no {component}* benchmark")
+
+    for error in errors:
+        print(error)
+    return 1 if errors else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
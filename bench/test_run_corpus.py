@@ -0,0 +1,163 @@
+#!/usr/bin/env python3
+"""Tests of the regression checks of run_corpus.py.
+
+    bench/test_run_corpus.py
+
+If CLOX and CLOX_ALLOC_STATS give the paths of the interpreter and of its clox_alloc_stats build,
+the runner is also run on a small workload, against a baseline it saved itself.
+"""
+
+import copy
+import json
+import os
+import subprocess
+import sys
+import tempfile
+import unittest
+from pathlib import Path
+
+sys.path.insert(0, str(Path(__file__).resolve().parent))
+
+import run_corpus  # noqa: E402
+
+MB = 1024 * 1024
+
+
+def result(wall_times=(1.0,) * 5, instructions=1000, peak_rss=10 * MB, allocations=100):
+    return {
+        "wall_times": list(wall_times),
+        "instructions": instructions,
+        "peak_rss": peak_rss,
+        "allocations": allocations,
+        "collections": 0,
+    }
+
+
+def regressions(current, baseline, threshold=0.05, rss_threshold=0.10, alpha=0.01):
+    return run_corpus.regressions("w", current, baseline, threshold, rss_threshold, alpha)
+
+
+# ------------------------------------------------------------------------------------------------ #
+
+
+class PSlower(unittest.TestCase):
+    def test_all_slower(self):
+        # Only one arrangement out of C(10, 5) puts all current samples above the baseline.
+        p = run_corpus.p_slower([2, 3, 4, 5, 6], [1, 1, 1, 1, 1])
+        self.assertAlmostEqual(p, 1 / 252)
+
+    def test_all_faster(self):
+        self.assertEqual(run_corpus.p_slower([1, 1, 1, 1, 1], [2, 3, 4, 5, 6]), 1.0)
+
+    def test_identical(self):
+        self.assertGreaterEqual(run_corpus.p_slower([1, 2, 3], [1, 2, 3]), 0.5)
+
+
+class Regressions(unittest.TestCase):
+    def test_same(self):
+        self.assertEqual(regressions(result(), result()), [])
+
+    def test_counts_within_threshold(self):
+        current = result(instructions=1040, allocations=104)
+        self.assertEqual(regressions(current, result()), [])
+
+    def test_counts_above_threshold(self):
+        found = regressions(result(instructions=1100, allocations=110), result())
+        self.assertEqual(found, ["w: instructions 1000 -> 1100", "w: allocations 100 -> 110"])
+
+    def test_counts_missing(self):
+        # Allocations are not counted without a clox_alloc_stats build.
+        self.assertEqual(regressions(result(allocations=None), result()), [])
+        self.assertEqual(regressions(result(allocations=200), result(allocations=None)), [])
+
+    def test_wall_time_significantly_slower(self):
+        current = result(wall_times=[1.2, 1.21, 1.22, 1.23, 1.24])
+        baseline = result(wall_times=[1.0, 1.01, 1.02, 1.03, 1.04])
+        found = regressions(current, baseline)
+        self.assertEqual(len(found), 1)
+        self.assertTrue(found[0].startswith("w: wall time"))
+
+    def test_wall_time_slower_not_significant(self):
+        # The median is slower, but the samples overlap.
+        current = result(wall_times=[0.9, 1.0, 1.2, 1.3, 1.4])
+        baseline = result(wall_times=[1.0, 1.01, 1.02, 1.5, 1.6])
+        self.assertEqual(regressions(current, baseline), [])
+
+    def test_wall_time_significant_within_threshold(self):
+        current = result(wall_times=[1.02, 1.021, 1.022, 1.023, 1.024])
+        baseline = result(wall_times=[1.0, 1.001, 1.002, 1.003, 1.004])
+        self.assertEqual(regressions(current, baseline), [])
+
+    def test_peak_rss_within_rss_threshold(self):
+        # Above --threshold, but within --rss-threshold.
+        current = result(peak_rss=int(10.8 * MB))
+        self.assertEqual(regressions(current, result(peak_rss=10 * MB)), [])
+
+    def test_peak_rss_below_floor(self):
+        # Above --rss-threshold, but by less than 1 MB.
+        current = result(peak_rss=int(4.8 * MB))
+        self.assertEqual(regressions(current, result(peak_rss=4 * MB)), [])
+
+    def test_peak_rss_above_rss_threshold(self):
+        found = regressions(result(peak_rss=12 * MB), result(peak_rss=10 * MB))
+        self.assertEqual(found, ["w: peak RSS 10.0 -> 12.0 MB"])
+
+    def test_peak_rss_own_threshold(self):
+        current = result(peak_rss=12 * MB)
+        baseline = result(peak_rss=10 * MB)
+        self.assertEqual(regressions(current, baseline, rss_threshold=0.25), [])
+
+
+# ------------------------------------------------------------------------------------------------ #
+
+
+@unittest.skipUnless(
+    "CLOX" in os.environ and "CLOX_ALLOC_STATS" in os.environ, "CLOX or CLOX_ALLOC_STATS not set"
+)
+class Runner(unittest.TestCase):
+    def run_corpus(self, *args):
+        command = [
+            sys.executable,
+            str(Path(run_corpus.__file__)),
+            "--clox",
+            os.environ["CLOX"],
+            "--clox-alloc-stats",
+            os.environ["CLOX_ALLOC_STATS"],
+            "--workloads",
+            "arithmetic",
+            "--sizes",
+            "small",
+            "--repetitions",
+            "3",
+            *args,
+        ]
+        return subprocess.run(command, capture_output=True, text=True)
+
+    def test_baseline(self):
+        with tempfile.TemporaryDirectory(prefix="clox_corpus_test_") as directory:
+            saved = Path(directory) / "saved.json"
+            run = self.run_corpus("--save", str(saved))
+            self.assertEqual(run.returncode, 0, run.stdout + run.stderr)
+            results = json.loads(saved.read_text())
+            result = results["results"]["arithmetic/small"]
+            self.assertGreater(result["instructions"], 0)
+            self.assertGreater(result["allocations"], 0)
+
+            # Three repetitions are too few for wall times to ever be significant.
+            run = self.run_corpus("--baseline", str(saved))
+            self.assertEqual(run.returncode, 0, run.stdout + run.stderr)
+            self.assertNotIn("REGRESSION", run.stdout)
+
+            better = copy.deepcopy(results)
+            better["results"]["arithmetic/small"]["instructions"] //= 2
+            better["results"]["arithmetic/small"]["peak_rss"] -= 4 * MB
+            baseline = Path(directory) / "baseline.json"
+            baseline.write_text(json.dumps(better))
+            run = self.run_corpus("--baseline", str(baseline))
+            self.assertEqual(run.returncode, 1, run.stdout + run.stderr)
+            self.assertIn("REGRESSION arithmetic/small: instructions", run.stdout)
+            self.assertIn("REGRESSION arithmetic/small: peak RSS", run.stdout)
+
+
+if __name__ == "__main__":
+    unittest.main()
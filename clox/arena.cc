@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <utility>
+
+#include "clox/arena.hh"
+
+namespace clox {
+
+// ---------------------------------------------------------------------------------------------- //
+
+// The moved-from arena must not keep pointers to the blocks it no longer owns.
+
+Arena::Arena(Arena&& other) noexcept
+  : blocks_{std::exchange(other.blocks_, {})}
+  , large_blocks_{std::exchange(other.large_blocks_, {})}
+  , free_lists_{std::exchange(other.free_lists_, {})}
+  , current_{std::exchange(other.current_, nullptr)}
+  , end_{std::exchange(other.end_, nullptr)}
+  , allocated_{std::exchange(other.allocated_, 0)}
+  , reserved_{std::exchange(other.reserved_, 0)}
+{}
+
+Arena&
+Arena::operator=(Arena&& other) noexcept
+{
+  blocks_ = std::exchange(other.blocks_, {});
+  large_blocks_ = std::exchange(other.large_blocks_, {});
+  free_lists_ = std::exchange(other.free_lists_, {});
+  current_ = std::exchange(other.current_, nullptr);
+  end_ = std::exchange(other.end_, nullptr);
+  allocated_ = std::exchange(other.allocated_, 0);
+  reserved_ = std::exchange(other.reserved_, 0);
+  return *this;
+}
+
+// ---------------------------------------------------------------------------------------------- //
+
+std::size_t
+Arena::round_up(std::size_t size) noexcept
+{
+  return size == 0 ? granularity : (size + granularity - 1) / granularity * granularity;
+}
+
+void*
+Arena::allocate(std::size_t size, std::size_t alignment)
+{
+  assert(alignment <= alignof(std::max_align_t) and (alignment & (alignment - 1)) == 0);
+
+  if (size > max_small_size)
+  {
+    // Keep the current block, which may still have room for small objects.
+    // NOLINTNEXTLINE(*-avoid-c-arrays)
+    auto block = std::make_unique_for_overwrite<std::byte[]>(size);
+    auto* ptr = block.get();
+    large_blocks_.emplace(ptr, std::move(block));
+    reserved_ += size;
+    allocated_ += size;
+    return ptr;
+  }
+
+  size = round_up(size);
+  alignment = std::max(alignment, granularity);
+
+  if (const auto size_class = size / granularity;
+      alignment == granularity and size_class < free_lists_.size() and
+      free_lists_[size_class] != nullptr)
+  {
+    auto* ptr = free_lists_[size_class];
+    free_lists_[size_class] = *static_cast<void**>(ptr);
+    allocated_ += size;
+    return ptr;
+  }
+
+  const auto address = reinterpret_cast<std::uintptr_t>(current_);
+  const auto padding = (alignment - address % alignment) % alignment;
+  if (current_ == nullptr or static_cast<std::size_t>(end_ - current_) < padding + size)
+  {
+    add_block(block_size);
+    return allocate(size, alignment);
+  }
+
+  auto* ptr = current_ + padding;
+  current_ = ptr + size;
+  allocated_ += size;
+  return ptr;
+}
+
+void
+Arena::deallocate(void* ptr, std::size_t size) noexcept
+{
+  if (size > max_small_size)
+  {
+    large_blocks_.erase(ptr);
+    reserved_ -= size;
+    allocated_ -= size;
+    return;
+  }
+
+  // Small storage comes from a block, so the free lists have been allocated with it.
+  size = round_up(size);
+  auto*& head = free_lists_[size / granularity];
+  *static_cast<void**>(ptr) = head;
+  head = ptr;
+  allocated_ -= size;
+}
+
+void
+Arena::add_block(std::size_t size)
+{
+  if (free_lists_.empty())
+  {
+    free_lists_.resize(max_small_size / granularity + 1, nullptr);
+  }
+
+  // NOLINTNEXTLINE(*-avoid-c-arrays)
+  current_ = blocks_.emplace_back(std::make_unique_for_overwrite<std::byte[]>(size)).get();
+  end_ = current_ + size;
+  reserved_ += size;
+}
+
+// ---------------------------------------------------------------------------------------------- //
+
+Arena::Stats
+Arena::stats() const noexcept
+{
+  return {blocks_.size() + large_blocks_.size(), allocated_, reserved_};
+}
+
+// ---------------------------------------------------------------------------------------------- //
+
+} // namespace clox
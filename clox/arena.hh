@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace clox {
+
+// ---------------------------------------------------------------------------------------------- //
+
+// Bump allocator. Freed storage is kept in free lists, one per size, to be reused by later
+// allocations of the same size. All blocks are released at once when the arena is destroyed,
+// without calling destructors. Objects don't move when the arena is moved.
+class Arena
+{
+public:
+  struct Stats
+  {
+    std::size_t nb_blocks;
+    // Bytes handed out by allocate() and not deallocated yet.
+    std::size_t allocated;
+    // Bytes reserved from the system.
+    std::size_t reserved;
+  };
+
+public:
+  Arena() = default;
+
+  ~Arena() = default;
+  Arena(const Arena&) = delete;
+  Arena(Arena&&) noexcept;
+  Arena& operator=(const Arena&) = delete;
+  Arena& operator=(Arena&&) noexcept;
+
+  // Return storage for `size` bytes aligned on `alignment`, which must be a power of two no greater
+  // than alignof(std::max_align_t).
+  [[nodiscard]] void* allocate(std::size_t size, std::size_t alignment);
+
+  // Give back storage returned by allocate(), with the same `size`.
+  void deallocate(void* ptr, std::size_t size) noexcept;
+
+  // Construct a T, followed by `extra_size` bytes of uninitialized storage.
+  template<typename T, typename... Args>
+  [[nodiscard]] T* make(std::size_t extra_size, Args&&... args)
+  {
+    static_assert(std::is_trivially_destructible_v<T>, "Destructors are not called by Arena");
+    static_assert(alignof(T) <= alignof(std::max_align_t));
+
+    return new (allocate(sizeof(T) + extra_size, alignof(T))) T(std::forward<Args>(args)...);
+  }
+
+  // Give back an object created by make(), with the same `extra_size`.
+  template<typename T>
+  void dispose(const T* obj, std::size_t extra_size = 0) noexcept
+  {
+    deallocate(const_cast<T*>(obj), sizeof(T) + extra_size); // NOLINT(*-const-cast)
+  }
+
+  [[nodiscard]] Stats stats() const noexcept;
+
+private:
+  // Allocations larger than a quarter of this get their own block, so that at most a quarter of a
+  // block is wasted when moving to the next one.
+  static constexpr std::size_t block_size = 64 * 1024;
+  static constexpr std::size_t max_small_size = block_size / 4;
+
+  // Small allocations are rounded up to, and aligned on, multiples of this, so that all the
+  // storage in a free list can serve any allocation of its size.
+  static constexpr std::size_t granularity = alignof(void*);
+
+  [[nodiscard]] static std::size_t round_up(std::size_t size) noexcept;
+  void add_block(std::size_t size);
+
+private:
+  std::vector<std::unique_ptr<std::byte[]>> blocks_{}; // NOLINT(*-avoid-c-arrays)
+  // NOLINTNEXTLINE(*-avoid-c-arrays)
+  std::unordered_map<void*, std::unique_ptr<std::byte[]>> large_blocks_{};
+  // Heads of the free lists, indexed by size / granularity. Each free storage starts with a pointer
+  // to the next one.
+  std::vector<void*> free_lists_{};
+  std::byte* current_{nullptr};
+  std::byte* end_{nullptr};
+  std::size_t allocated_{0};
+  std::size_t reserved_{0};
+};
+
+// ---------------------------------------------------------------------------------------------- //
+
+} // namespace clox
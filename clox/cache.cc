@@ -0,0 +1,446 @@
+#include <array>
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <boost/leaf.hpp>
+#include <fmt/core.h>
+#include <unistd.h>
+
+#include "clox/cache.hh"
+#include "clox/detail/hash.hh"
+#include "clox/detail/offset_table.hh"
+#include "clox/mapped_file.hh"
+#include "clox/verify.hh"
+
+namespace clox {
+
+// ---------------------------------------------------------------------------------------------- //
+
+namespace /* anonymous */ {
+
+// A file is a header followed by sections, each of them an array of fixed-size entries. Integers
+// are stored in the native byte order: files are not meant to be moved across machines.
+
+constexpr auto file_magic = std::to_array<char>({'C', 'L', 'O', 'X', 'C', '\0', '\0', '\0'});
+// Bump when the layout of the file changes.
+constexpr std::uint32_t format_version = 2;
+constexpr std::uint32_t byte_order_mark = 0x0102'0304;
+// Sections are aligned, so that entries are aligned too in a mapped file.
+constexpr std::size_t section_alignment = 8;
+
+struct Section
+{
+  // In bytes, from the start of the file.
+  std::uint64_t offset;
+  std::uint64_t size;
+};
+
+struct Header
+{
+  std::array<char, file_magic.size()> magic;
+  std::uint32_t version;
+  std::uint32_t byte_order;
+  std::uint64_t instruction_set;
+  CacheKey key;
+  // Bytes of the instructions.
+  Section bytecode;
+  // detail::OffsetTable::Run.
+  Section source_offsets;
+  // ConstantEntry.
+  Section constants;
+  // StringEntry, referring to `characters`.
+  Section strings;
+  Section characters;
+  // Index of the name of each global variable in `strings`, ordered by global variable index.
+  Section globals;
+};
+
+enum class ConstantType : std::uint64_t
+{
+  number,
+  boolean,
+  nil,
+  string
+};
+
+struct ConstantEntry
+{
+  ConstantType type;
+  // Bits of a number, a boolean, or the index of a string in `strings`.
+  std::uint64_t payload;
+};
+
+struct StringEntry
+{
+  // In `characters`.
+  std::uint64_t offset;
+  std::uint64_t size;
+};
+
+using GlobalEntry = std::uint64_t;
+
+static_assert(std::has_unique_object_representations_v<Header>, "Header must not have padding");
+
+// Changes when instructions are added, removed, reordered or resized, which changes the meaning of
+// the bytecode.
+std::uint64_t
+instruction_set() noexcept
+{
+  static const auto fingerprint = []
+  {
+    auto description = std::string{};
+    // NOLINTBEGIN(cppcoreguidelines-macro-usage)
+#define CLOX_DESCRIBE_OPCODE(name, type)                                                           \
+  description += #name;                                                                            \
+  description += static_cast<char>(instruction_size_v<type>);
+
+    CLOX_OPCODES(CLOX_DESCRIBE_OPCODE)
+
+#undef CLOX_DESCRIBE_OPCODE
+    // NOLINTEND(cppcoreguidelines-macro-usage)
+    return detail::hash(description);
+  }();
+  return fingerprint;
+}
+
+// ---------------------------------------------------------------------------------------------- //
+
+class Writer
+{
+public:
+  Writer()
+    : bytes_(sizeof(Header))
+  {}
+
+  template<typename T>
+  [[nodiscard]] Section append(std::span<const T> entries)
+  {
+    static_assert(std::is_trivially_copyable_v<T>);
+
+    bytes_.resize((bytes_.size() + section_alignment - 1) / section_alignment * section_alignment);
+    const auto offset = bytes_.size();
+    bytes_.resize(offset + entries.size_bytes());
+    if (not entries.empty())
+    {
+      std::memcpy(&bytes_[offset], entries.data(), entries.size_bytes());
+    }
+    return {offset, entries.size_bytes()};
+  }
+
+  [[nodiscard]] std::vector<std::uint8_t> finish(const Header& header) &&
+  {
+    std::memcpy(bytes_.data(), &header, sizeof(header));
+    return std::move(bytes_);
+  }
+
+private:
+  std::vector<std::uint8_t> bytes_;
+};
+
+// Strings of the file, each stored once.
+class StringTable
+{
+public:
+  [[nodiscard]] std::uint64_t add(std::string_view str)
+  {
+    const auto [it, inserted] = indexes_.try_emplace(str, entries_.size());
+    if (inserted)
+    {
+      entries_.push_back({characters_.size(), str.size()});
+      characters_.append(str);
+    }
+    return it->second;
+  }
+
+  [[nodiscard]] std::span<const StringEntry> entries() const noexcept { return entries_; }
+  [[nodiscard]] std::span<const char> characters() const noexcept { return characters_; }
+
+private:
+  std::unordered_map<std::string_view, std::uint64_t> indexes_{};
+  std::vector<StringEntry> entries_{};
+  std::string characters_{};
+};
+
+// ---------------------------------------------------------------------------------------------- //
+
+// Entries of a section of a mapped file. They are copied out one at a time, as the mapping holds
+// bytes rather than objects.
+template<typename T>
+class Entries
+{
+public:
+  explicit Entries(std::span<const std::uint8_t> bytes) noexcept
+    : bytes_{bytes}
+  {}
+
+  [[nodiscard]] std::size_t size() const noexcept { return bytes_.size() / sizeof(T); }
+
+  // Precondition: i < size().
+  [[nodiscard]] T operator[](std::size_t i) const noexcept
+  {
+    auto entry = T{};
+    std::memcpy(&entry, bytes_.subspan(i * sizeof(T), sizeof(T)).data(), sizeof(T));
+    return entry;
+  }
+
+private:
+  std::span<const std::uint8_t> bytes_;
+};
+
+// Return nothing if `section` doesn't fit in `file` or doesn't hold a whole number of entries.
+template<typename T>
+std::optional<Entries<T>>
+entries(std::span<const std::uint8_t> file, Section section) noexcept
+{
+  if (section.offset > file.size() or section.size > file.size() - section.offset or
+      section.size % sizeof(T) != 0)
+  {
+    return {};
+  }
+  return Entries<T>{file.subspan(section.offset, section.size)};
+}
+
+// Return nothing if the runs don't cover exactly `size` bytes, in order.
+std::optional<detail::OffsetTable>
+read_source_offsets(const Entries<detail::OffsetTable::Run>& entries, std::size_t size)
+{
+  auto runs = std::vector<detail::OffsetTable::Run>{};
+  runs.reserve(entries.size());
+  for (auto i = std::size_t{0}; i < entries.size(); ++i)
+  {
+    const auto run = entries[i];
+    if (runs.empty() ? run.offset != 0 : run.offset <= runs.back().offset)
+    {
+      return {};
+    }
+    runs.push_back(run);
+  }
+  if (runs.empty() ? size != 0 : runs.back().offset >= size)
+  {
+    return {};
+  }
+  return detail::OffsetTable{std::move(runs), size};
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------------------------- //
+
+CacheKey
+cache_key(std::string_view source) noexcept
+{
+  return {detail::hash(source), source.size()};
+}
+
+std::filesystem::path
+cache_path(const std::filesystem::path& source_path)
+{
+  auto path = std::filesystem::path{source_path};
+  if (path.extension() == ".cloxc")
+  {
+    // Replacing the extension would overwrite the source with its bytecode.
+    return path += ".cloxc";
+  }
+  return path.replace_extension(".cloxc");
+}
+
+// ---------------------------------------------------------------------------------------------- //
+
+void
+save_cache(const std::filesystem::path& path, const Chunk& chunk, CacheKey key)
+{
+  const auto& code = *chunk.code;
+  auto strings = StringTable{};
+
+  auto constants = std::vector<ConstantEntry>{};
+  constants.reserve(code.nb_constants());
+  for (const auto constant : code.constants())
+  {
+    if (constant.is<double>())
+    {
+      constants.push_back(
+        {ConstantType::number, std::bit_cast<std::uint64_t>(constant.unchecked_as<double>())});
+    }
+    else if (constant.is<bool>())
+    {
+      constants.push_back({ConstantType::boolean, constant.unchecked_as<bool>() ? 1U : 0U});
+    }
+    else if (constant.is<Nil>())
+    {
+      constants.push_back({ConstantType::nil, 0});
+    }
+    else
+    {
+      const auto* str = chunk.memory->intern(constant).unchecked_as<const ObjString*>();
+      constants.push_back({ConstantType::string, strings.add(str->str())});
+    }
+  }
+
+  // The names must outlive `strings`, which refers to them.
+  const auto names = chunk.memory->global_variable_names();
+  auto globals = std::vector<GlobalEntry>{};
+  globals.reserve(names.size());
+  for (const auto name : names)
+  {
+    globals.push_back(strings.add(name));
+  }
+
+  auto writer = Writer{};
+  auto header = Header{};
+  header.magic = file_magic;
+  header.version = format_version;
+  header.byte_order = byte_order_mark;
+  header.instruction_set = instruction_set();
+  header.key = key;
+  header.bytecode = writer.append(code.bytecode());
+  header.source_offsets = writer.append(code.source_offsets().runs());
+  header.constants = writer.append(std::span<const ConstantEntry>{constants});
+  header.strings = writer.append(strings.entries());
+  header.characters = writer.append(strings.characters());
+  header.globals = writer.append(std::span<const GlobalEntry>{globals});
+  const auto bytes = std::move(writer).finish(header);
+
+  auto tmp_path = path;
+  tmp_path += fmt::format(".{}.tmp", ::getpid());
+  {
+    auto out = std::ofstream{tmp_path, std::ios::binary | std::ios::trunc};
+    out.write(reinterpret_cast<const char*>(bytes.data()), // NOLINT(*-reinterpret-cast)
+              static_cast<std::streamsize>(bytes.size()));
+    if (not out.flush())
+    {
+      auto ec = std::error_code{};
+      std::filesystem::remove(tmp_path, ec);
+      throw std::system_error{std::make_error_code(std::errc::io_error), tmp_path.string()};
+    }
+  }
+  std::filesystem::rename(tmp_path, path);
+}
+
+// ---------------------------------------------------------------------------------------------- //
+
+std::optional<Chunk>
+load_cache(const std::filesystem::path& path, CacheKey key, GcConfig gc_config)
+{
+  auto file = std::optional<MappedFile>{};
+  try
+  {
+    file.emplace(path);
+  }
+  catch (const std::system_error&)
+  {
+    return {};
+  }
+  const auto bytes = file->bytes();
+
+  auto header = Header{};
+  if (bytes.size() < sizeof(header))
+  {
+    return {};
+  }
+  std::memcpy(&header, bytes.data(), sizeof(header));
+  if (header.magic != file_magic or header.version != format_version or
+      header.byte_order != byte_order_mark or header.instruction_set != instruction_set() or
+      header.key != key)
+  {
+    return {};
+  }
+
+  const auto bytecode = entries<std::uint8_t>(bytes, header.bytecode);
+  const auto source_offsets = entries<detail::OffsetTable::Run>(bytes, header.source_offsets);
+  const auto constants = entries<ConstantEntry>(bytes, header.constants);
+  const auto strings = entries<StringEntry>(bytes, header.strings);
+  const auto characters = entries<char>(bytes, header.characters);
+  const auto globals = entries<GlobalEntry>(bytes, header.globals);
+  if (not(bytecode and source_offsets and constants and strings and characters and globals))
+  {
+    return {};
+  }
+
+  const auto offset_table = read_source_offsets(*source_offsets, header.bytecode.size);
+  if (not offset_table)
+  {
+    return {};
+  }
+
+  // Strings are viewed in the mapping, and only copied when interned.
+  const auto all_characters = bytes.subspan(header.characters.offset, header.characters.size);
+  const auto string = [&](std::uint64_t index) -> std::optional<std::string_view>
+  {
+    if (index >= strings->size())
+    {
+      return {};
+    }
+    const auto entry = (*strings)[index];
+    if (entry.offset > all_characters.size() or entry.size > all_characters.size() - entry.offset)
+    {
+      return {};
+    }
+    const auto chars = all_characters.subspan(entry.offset, entry.size);
+    // NOLINTNEXTLINE(*-reinterpret-cast)
+    return std::string_view{reinterpret_cast<const char*>(chars.data()), chars.size()};
+  };
+
+  auto memory = std::make_shared<Memory>(gc_config);
+  auto code = std::make_shared<Code>();
+  memory->add_code(code);
+
+  for (auto i = std::size_t{0}; i < globals->size(); ++i)
+  {
+    const auto name = string((*globals)[i]);
+    // Names are unique, so that each of them gets the index it had when the file was written.
+    if (not name or detail::to_integer(memory->maybe_add_global_variable(*name)) != i)
+    {
+      return {};
+    }
+  }
+
+  for (auto i = std::size_t{0}; i < constants->size(); ++i)
+  {
+    const auto [type, payload] = (*constants)[i];
+    auto value = Value{};
+    switch (type)
+    {
+      case ConstantType::number:
+        value = std::bit_cast<double>(payload);
+        break;
+      case ConstantType::boolean:
+        value = payload != 0;
+        break;
+      case ConstantType::nil:
+        value = Nil{};
+        break;
+      case ConstantType::string:
+        if (const auto str = string(payload))
+        {
+          value = memory->make_string(*str);
+          break;
+        }
+        return {};
+      default:
+        return {};
+    }
+    static_cast<void>(code->add_constant(value));
+  }
+
+  code->assign(bytes.subspan(header.bytecode.offset, header.bytecode.size), *offset_table);
+
+  return boost::leaf::try_handle_all(
+    [&]() -> boost::leaf::result<std::optional<Chunk>>
+    {
+      BOOST_LEAF_AUTO(chunk, verify(Chunk{std::move(code), std::move(memory)}));
+      return std::optional<Chunk>{std::move(chunk)};
+    },
+    [] { return std::optional<Chunk>{}; });
+}
+
+// ---------------------------------------------------------------------------------------------- //
+
+} // namespace clox
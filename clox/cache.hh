@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string_view>
+
+#include "clox/chunk.hh"
+#include "clox/memory.hh"
+
+namespace clox {
+
+// ---------------------------------------------------------------------------------------------- //
+
+// Compiled chunks can be saved to .cloxc files, so that later runs of the same source skip the
+// scanner and the compiler. A file holds the bytecode, the offsets in the source of its
+// instructions, its constants, the strings they refer to and the names of the global variables, and
+// is only valid for the source it was compiled from and for the version of clox which wrote it.
+
+// Identifies a source.
+struct CacheKey
+{
+  std::uint64_t source_hash;
+  std::uint64_t source_size;
+
+  friend bool operator==(const CacheKey&, const CacheKey&) = default;
+};
+
+[[nodiscard]] CacheKey
+cache_key(std::string_view source) noexcept;
+
+// Where the cache of the source at `source_path` is stored: `script.clox` is cached in
+// `script.cloxc`. It's never the source itself: `script.cloxc` is cached in `script.cloxc.cloxc`.
+[[nodiscard]] std::filesystem::path
+cache_path(const std::filesystem::path& source_path);
+
+// Write `chunk`, compiled from the source identified by `key`, to `path`. The file is first written
+// aside and then renamed, so that concurrent readers never see a partial file. Throw
+// std::system_error if it can't be written.
+void
+save_cache(const std::filesystem::path& path, const Chunk& chunk, CacheKey key);
+
+// Load the chunk saved in `path`, with a new Memory. The file is mapped rather than read. Return
+// nothing if it doesn't exist, if it was not written for `key` by this version of clox, or if it's
+// corrupted: the bytecode is verified before being returned. Lines are not saved: give the code a
+// LineIndex of the source to report them.
+[[nodiscard]] std::optional<Chunk>
+load_cache(const std::filesystem::path& path, CacheKey key, GcConfig gc_config = {});
+
+// ---------------------------------------------------------------------------------------------- //
+
+} // namespace clox
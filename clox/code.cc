@@ -1,4 +1,9 @@
+#include <array>
+#include <cassert>
 #include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <utility>
 
 #include "clox/code.hh"
 
@@ -6,11 +11,49 @@ namespace clox {
 
 // ---------------------------------------------------------------------------------------------- //
 
+namespace /* anonymous */ {
+
+template<typename Op>
+Opcode
+decode_as(Code::const_iterator code_cit)
+{
+  return Code::operands<Op>(code_cit);
+}
+
+template<std::size_t... Is>
+constexpr auto
+make_decoders(std::index_sequence<Is...>)
+{
+  using Decoder = Opcode (*)(Code::const_iterator);
+  return std::array<Decoder, sizeof...(Is)>{&decode_as<std::variant_alternative_t<Is, Opcode>>...};
+}
+
+template<std::size_t... Is>
+constexpr auto
+make_instruction_sizes(std::index_sequence<Is...>)
+{
+  return std::array<std::uint8_t, sizeof...(Is)>{
+    instruction_size_v<std::variant_alternative_t<Is, Opcode>>...};
+}
+
+constexpr auto decoders = make_decoders(std::make_index_sequence<std::variant_size_v<Opcode>>{});
+
+constexpr auto instruction_sizes =
+  make_instruction_sizes(std::make_index_sequence<std::variant_size_v<Opcode>>{});
+
+} // namespace
+
+// ---------------------------------------------------------------------------------------------- //
+
 detail::ConstantIndex
 Code::add_constant(Value v)
 {
-  const auto it = constants_.insert(constants_.end(), v);
-  const auto index = static_cast<std::uint16_t>(it - constants_.cbegin());
+  if (constants_.size() > std::numeric_limits<std::uint32_t>::max())
+  {
+    throw std::length_error{"Too many constants"};
+  }
+  const auto index = static_cast<std::uint32_t>(constants_.size());
+  constants_.push_back(v);
 
   return detail::ConstantIndex{index};
 }
@@ -18,7 +61,33 @@ Code::add_constant(Value v)
 Value
 Code::get_constant(detail::ConstantIndex index) const
 {
-  return constants_[static_cast<std::uint16_t>(index)];
+  return constants_[static_cast<std::uint32_t>(index)];
+}
+
+std::size_t
+Code::nb_constants() const noexcept
+{
+  return constants_.size();
+}
+
+std::span<const Value>
+Code::constants() const noexcept
+{
+  return constants_;
+}
+
+// ---------------------------------------------------------------------------------------------- //
+
+std::size_t
+Code::max_stack_depth() const noexcept
+{
+  return max_stack_depth_;
+}
+
+void
+Code::set_max_stack_depth(std::size_t depth) noexcept
+{
+  max_stack_depth_ = depth;
 }
 
 // ---------------------------------------------------------------------------------------------- //
@@ -29,6 +98,18 @@ Code::cbegin() const noexcept
   return code_.cbegin();
 }
 
+Code::const_iterator
+Code::cend() const noexcept
+{
+  return code_.cend();
+}
+
+std::size_t
+Code::size() const noexcept
+{
+  return code_.size();
+}
+
 // ---------------------------------------------------------------------------------------------- //
 
 std::size_t
@@ -40,9 +121,108 @@ Code::code_offset(Code::const_iterator code_cit) const
 // ---------------------------------------------------------------------------------------------- //
 
 std::optional<std::size_t>
-Code::line(Code::const_iterator code_cit) const
+Code::source_offset(Code::const_iterator code_cit) const
+{
+  return source_offsets_.source_offset(code_offset(code_cit));
+}
+
+std::optional<SourceLocation>
+Code::location(Code::const_iterator code_cit) const
+{
+  const auto offset = source_offset(code_cit);
+  if (not offset or not line_index_)
+  {
+    return {};
+  }
+  return line_index_->location(*offset);
+}
+
+void
+Code::set_line_index(std::shared_ptr<const LineIndex> line_index) noexcept
+{
+  line_index_ = std::move(line_index);
+}
+
+std::size_t
+Code::nb_source_offset_runs() const noexcept
+{
+  return source_offsets_.nb_runs();
+}
+
+// ---------------------------------------------------------------------------------------------- //
+
+std::span<const std::uint8_t>
+Code::bytecode() const noexcept
+{
+  return code_;
+}
+
+const detail::OffsetTable&
+Code::source_offsets() const noexcept
+{
+  return source_offsets_;
+}
+
+void
+Code::assign(std::span<const std::uint8_t> bytecode, detail::OffsetTable source_offsets)
+{
+  assert(source_offsets.size() == bytecode.size());
+  code_.assign(bytecode.begin(), bytecode.end());
+  source_offsets_ = std::move(source_offsets);
+}
+
+// ---------------------------------------------------------------------------------------------- //
+
+Opcode
+Code::decode(Code::const_iterator code_cit)
+{
+  return decoders[*code_cit](code_cit);
+}
+
+Code::const_iterator
+Code::next(Code::const_iterator code_cit)
+{
+  return std::next(code_cit, instruction_sizes[*code_cit]);
+}
+
+std::size_t
+Code::instruction_size(Code::const_iterator code_cit)
+{
+  return instruction_sizes[*code_cit];
+}
+
+// ---------------------------------------------------------------------------------------------- //
+
+void
+Code::truncate(std::size_t size, std::size_t nb_constants)
+{
+  code_.resize(size);
+  source_offsets_.truncate(size);
+  constants_.resize(nb_constants);
+}
+
+// ---------------------------------------------------------------------------------------------- //
+
+std::vector<Instruction>
+Code::instructions() const
+{
+  auto instructions = std::vector<Instruction>{};
+  for (auto cit = cbegin(); cit != cend(); cit = next(cit))
+  {
+    instructions.push_back({decode(cit), source_offset(cit)});
+  }
+  return instructions;
+}
+
+void
+Code::set_instructions(const std::vector<Instruction>& instructions)
 {
-  return lines_[code_offset(code_cit)];
+  code_.clear();
+  source_offsets_.clear();
+  for (const auto& [opcode, offset] : instructions)
+  {
+    std::visit([&, offset = offset](const auto& op) { add_opcode(op, offset); }, opcode);
+  }
 }
 
 // ---------------------------------------------------------------------------------------------- //
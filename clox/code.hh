@@ -1,11 +1,21 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
 #include <iosfwd>
+#include <iterator>
+#include <memory>
 #include <optional>
+#include <span>
+#include <type_traits>
 #include <unordered_map>
 #include <vector>
 
 #include "clox/detail/index.hh"
+#include "clox/detail/offset_table.hh"
+#include "clox/line_index.hh"
 #include "clox/opcode.hh"
 #include "clox/value.hh"
 
@@ -13,31 +23,110 @@ namespace clox {
 
 // ---------------------------------------------------------------------------------------------- //
 
+// An instruction in its typed form, with the offset in the source of the token it comes from.
+struct Instruction
+{
+  Opcode opcode;
+  std::optional<std::size_t> source_offset;
+};
+
+// ---------------------------------------------------------------------------------------------- //
+
 class Code
 {
 public:
-  using const_iterator = std::vector<Opcode>::const_iterator;
+  using const_iterator = std::vector<std::uint8_t>::const_iterator;
 
 public:
-  template<typename Opcode>
-  void add_opcode(Opcode&& op, std::optional<std::size_t> line = {})
+  template<typename Op>
+  void add_opcode(const Op& op, std::optional<std::size_t> source_offset = {})
   {
-    code_.emplace_back(std::forward<Opcode>(op));
-    lines_.emplace_back(line);
+    static_assert(std::is_trivially_copyable_v<Op>);
+
+    code_.push_back(opcode_v<Op>);
+    if constexpr (operands_size_v<Op> != 0)
+    {
+      const auto bytes = std::bit_cast<std::array<std::uint8_t, sizeof(Op)>>(op);
+      code_.insert(code_.end(), bytes.cbegin(), bytes.cend());
+    }
+    source_offsets_.add(instruction_size_v<Op>, source_offset);
   }
 
   [[nodiscard]] detail::ConstantIndex add_constant(Value);
   [[nodiscard]] Value get_constant(detail::ConstantIndex) const;
+  [[nodiscard]] std::size_t nb_constants() const noexcept;
+  [[nodiscard]] std::span<const Value> constants() const noexcept;
+
+  // Maximal depth of the stack during the execution of this code, as computed by verify().
+  [[nodiscard]] std::size_t max_stack_depth() const noexcept;
+  void set_max_stack_depth(std::size_t) noexcept;
 
   [[nodiscard]] const_iterator cbegin() const noexcept;
+  [[nodiscard]] const_iterator cend() const noexcept;
+
+  // Size of the bytecode, in bytes.
+  [[nodiscard]] std::size_t size() const noexcept;
 
   [[nodiscard]] std::size_t code_offset(const_iterator code_cit) const;
-  [[nodiscard]] std::optional<std::size_t> line(const_iterator code_cit) const;
+  [[nodiscard]] std::optional<std::size_t> source_offset(const_iterator code_cit) const;
+
+  // Where the instruction starting at `code_cit` comes from in the source, if it's known and if the
+  // code has an index of the lines of its source.
+  [[nodiscard]] std::optional<SourceLocation> location(const_iterator code_cit) const;
+  void set_line_index(std::shared_ptr<const LineIndex>) noexcept;
+
+  // Number of entries of the run-length encoded table of source offsets.
+  [[nodiscard]] std::size_t nb_source_offset_runs() const noexcept;
+
+  // Raw bytecode and source offsets, to be serialized.
+  [[nodiscard]] std::span<const std::uint8_t> bytecode() const noexcept;
+  [[nodiscard]] const detail::OffsetTable& source_offsets() const noexcept;
+
+  // Replace the bytecode and its source offsets by deserialized ones. Constants are kept.
+  // Precondition: source_offsets.size() == bytecode.size().
+  void assign(std::span<const std::uint8_t> bytecode, detail::OffsetTable source_offsets);
+
+  // Read the operands of the instruction starting at `code_cit`, which must be of type `Op`.
+  template<typename Op>
+  [[nodiscard]] static Op operands(const_iterator code_cit) noexcept
+  {
+    if constexpr (operands_size_v<Op> == 0)
+    {
+      return Op{};
+    }
+    else
+    {
+      auto bytes = std::array<std::uint8_t, sizeof(Op)>{};
+      std::copy_n(std::next(code_cit), sizeof(Op), bytes.begin());
+      return std::bit_cast<Op>(bytes);
+    }
+  }
+
+  // Get the instruction starting at `code_cit` back to its typed form.
+  [[nodiscard]] static Opcode decode(const_iterator code_cit);
+
+  // Get an iterator on the instruction following the one starting at `code_cit`.
+  [[nodiscard]] static const_iterator next(const_iterator code_cit);
+
+  // Size, in bytes, of the instruction starting at `code_cit`.
+  [[nodiscard]] static std::size_t instruction_size(const_iterator code_cit);
+
+  // Remove the bytecode after its first `size` bytes and the constants after the first
+  // `nb_constants`, to replace the last instructions.
+  void truncate(std::size_t size, std::size_t nb_constants);
+
+  // Decode all instructions, to be transformed by optimization passes.
+  [[nodiscard]] std::vector<Instruction> instructions() const;
+
+  // Replace the bytecode by the encoding of `instructions`. Constants are kept.
+  void set_instructions(const std::vector<Instruction>& instructions);
 
 private:
-  std::vector<Opcode> code_{};
-  std::vector<std::optional<std::size_t>> lines_{};
+  std::vector<std::uint8_t> code_{};
+  detail::OffsetTable source_offsets_{};
+  std::shared_ptr<const LineIndex> line_index_{};
   std::vector<Value> constants_{};
+  std::size_t max_stack_depth_{0};
 };
 
 // ---------------------------------------------------------------------------------------------- //
@@ -1,11 +1,22 @@
+#include <bit>
 #include <cassert>
+#include <charconv>
+#include <cstdint>
 #include <functional>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
 
 #include <fmt/core.h>
 #include <magic_enum.hpp>
 
 #include "clox/compile.hh"
 #include "clox/memory.hh"
+#include "clox/peephole.hh"
+#include "clox/verify.hh"
 
 namespace clox {
 
@@ -17,31 +28,260 @@ namespace {
 
 template<typename Opcode>
 void
-emit(CompileContext& cxt, std::size_t line, Opcode&& op)
+emit(CompileContext& cxt, std::size_t source_offset, Opcode&& op)
 {
-  cxt.chunk.code->add_opcode(std::forward<Opcode>(op), line);
+  cxt.trailing_constants.clear();
+  cxt.chunk.code->add_opcode(std::forward<Opcode>(op), source_offset);
 }
 
 template<typename Opcode, typename... Opcodes>
 void
-emit(CompileContext& cxt, std::size_t line, Opcode&& op, Opcodes&&... ops)
+emit(CompileContext& cxt, std::size_t source_offset, Opcode&& op, Opcodes&&... ops)
 {
-  cxt.chunk.code->add_opcode(std::forward<Opcode>(op), line);
-  emit(cxt, line, std::forward<Opcodes>(ops)...);
+  emit(cxt, source_offset, std::forward<Opcode>(op));
+  emit(cxt, source_offset, std::forward<Opcodes>(ops)...);
+}
+
+template<template<typename> typename BasicOp, typename Index>
+void
+add_indexed_opcode(Code& code, std::size_t source_offset, Index index)
+{
+  if (ShortIndex<Index>::fits(index))
+  {
+    code.add_opcode(BasicOp<ShortIndex<Index>>{index}, source_offset);
+  }
+  else
+  {
+    code.add_opcode(BasicOp<Index>{index}, source_offset);
+  }
+}
+
+// Emit the short form of an instruction whose operand is an index if the index fits in it, its
+// long form otherwise.
+template<template<typename> typename BasicOp, typename Index>
+void
+emit_indexed(CompileContext& cxt, std::size_t source_offset, Index index)
+{
+  cxt.trailing_constants.clear();
+  add_indexed_opcode<BasicOp>(*cxt.chunk.code, source_offset, index);
+}
+
+std::optional<ConstantKey>
+constant_key(Value value)
+{
+  if (value.is<double>())
+  {
+    return std::bit_cast<std::uint64_t>(value.unchecked_as<double>());
+  }
+  else if (value.is<const ObjString*>())
+  {
+    return value.unchecked_as<const ObjString*>();
+  }
+  return {};
+}
+
+ConstantIndex
+add_constant(CompileContext& cxt, Value value)
+{
+  const auto key = constant_key(value);
+  if (key)
+  {
+    if (const auto search = cxt.constant_indexes.find(*key); search != cxt.constant_indexes.end())
+    {
+      return search->second;
+    }
+  }
+
+  const auto index = cxt.chunk.code->add_constant(value);
+  if (key)
+  {
+    cxt.constant_indexes.emplace(*key, index);
+  }
+  return index;
+}
+
+// Remove the last instructions and the constants they added.
+void
+truncate(CompileContext& cxt, const TrailingConstant& first_removed)
+{
+  auto& code = *cxt.chunk.code;
+  for (auto i = first_removed.nb_constants; i < code.nb_constants(); ++i)
+  {
+    const auto index = ConstantIndex{static_cast<std::uint32_t>(i)};
+    if (const auto key = constant_key(code.get_constant(index)))
+    {
+      cxt.constant_indexes.erase(*key);
+    }
+  }
+  code.truncate(first_removed.code_size, first_removed.nb_constants);
+}
+
+// Load a constant, and remember it so that it can be folded with the operators which follow.
+void
+emit_constant(CompileContext& cxt, std::size_t source_offset, Value value)
+{
+  auto& code = *cxt.chunk.code;
+  const auto trailing_constant = TrailingConstant{code.size(), code.nb_constants(), value};
+
+  if (value.is<bool>())
+  {
+    if (value.unchecked_as<bool>())
+    {
+      code.add_opcode(OpTrue{}, source_offset);
+    }
+    else
+    {
+      code.add_opcode(OpFalse{}, source_offset);
+    }
+  }
+  else if (value.is<Nil>())
+  {
+    code.add_opcode(OpNil{}, source_offset);
+  }
+  else
+  {
+    add_indexed_opcode<BasicOpConstant>(code, source_offset, add_constant(cxt, value));
+  }
+
+  cxt.trailing_constants.push_back(trailing_constant);
+}
+
+// Compute the result of an operator applied to constants. Operations which would fail at runtime
+// are not folded, so that the error is still reported.
+
+std::optional<Value>
+fold(Memory&, OpEqual, std::span<const TrailingConstant> operands)
+{
+  return operands[0].value == operands[1].value;
+}
+
+std::optional<Value>
+fold(Memory&, OpNot, std::span<const TrailingConstant> operands)
+{
+  return operands[0].value.falsey();
+}
+
+std::optional<Value>
+fold(Memory&, OpNegate, std::span<const TrailingConstant> operands)
+{
+  if (const auto value = operands[0].value; value.is<double>())
+  {
+    return -value.unchecked_as<double>();
+  }
+  return {};
+}
+
+template<typename Impl>
+std::optional<Value>
+fold(Memory& memory, OpBinary<Impl>, std::span<const TrailingConstant> operands)
+{
+  const auto lhs = operands[0].value;
+  const auto rhs = operands[1].value;
+
+  if constexpr (std::is_invocable_v<Impl, Value, Value>)
+  {
+    return Impl{}(lhs, rhs);
+  }
+  else
+  {
+    if (lhs.is<double>() and rhs.is<double>())
+    {
+      return Impl{}(lhs.unchecked_as<double>(), rhs.unchecked_as<double>());
+    }
+    else if constexpr (std::is_same_v<Impl, OpAddImpl>)
+    {
+      if (lhs.is<const ObjString*>() and rhs.is<const ObjString*>())
+      {
+        auto str = std::string{lhs.unchecked_as<const ObjString*>()->str()};
+        str += rhs.unchecked_as<const ObjString*>()->str();
+        return memory.make_string(str);
+      }
+    }
+    return {};
+  }
+}
+
+// Emit an operator, or replace it and its operands by its result if they are all constants.
+template<typename Op>
+void
+emit_operator(CompileContext& cxt, std::size_t source_offset, Op op)
+{
+  auto& trailing_constants = cxt.trailing_constants;
+
+  if (cxt.fold_constants and trailing_constants.size() >= Op::pops)
+  {
+    const auto operands =
+      std::span{trailing_constants}.subspan(trailing_constants.size() - Op::pops);
+    if (const auto result = fold(*cxt.chunk.memory, op, operands))
+    {
+      truncate(cxt, operands.front());
+      trailing_constants.resize(trailing_constants.size() - Op::pops);
+      emit_constant(cxt, source_offset, *result);
+      return;
+    }
+  }
+
+  emit(cxt, source_offset, op);
+}
+
+template<typename Op, typename... Ops>
+void
+emit_operator(CompileContext& cxt, std::size_t source_offset, Op op, Ops... ops)
+{
+  emit_operator(cxt, source_offset, op);
+  emit_operator(cxt, source_offset, ops...);
+}
+
+// Find the global variables which are defined once and never assigned, so that their uses can be
+// replaced by their initial value when it's a constant.
+std::unordered_set<std::string_view>
+find_effectively_constant_globals(Scanner scanner)
+{
+  auto nb_definitions = std::unordered_map<std::string_view, std::size_t>{};
+  auto assigned = std::unordered_set<std::string_view>{};
+
+  auto before_previous = Token{};
+  auto previous = Token{};
+  for (auto current = scanner.next_token(); current.type != TokenType::eof;
+       current = scanner.next_token())
+  {
+    if (current.type == TokenType::identifier and previous.type == TokenType::var)
+    {
+      ++nb_definitions[current.token];
+    }
+    else if (current.type == TokenType::equal and previous.type == TokenType::identifier and
+             before_previous.type != TokenType::var)
+    {
+      assigned.insert(previous.token);
+    }
+    before_previous = previous;
+    previous = current;
+  }
+
+  auto globals = std::unordered_set<std::string_view>{};
+  for (const auto& [name, nb] : nb_definitions)
+  {
+    if (nb == 1 and not assigned.contains(name))
+    {
+      globals.insert(name);
+    }
+  }
+  return globals;
 }
 
 } // namespace
 
 // ---------------------------------------------------------------------------------------------- //
 
-Compile::Compile(Scanner&& scanner)
+Compile::Compile(Scanner&& scanner, opt_optimize optimize)
   : scanner_{std::move(scanner)}
+  , optimize_{optimize}
 {}
 
 // ---------------------------------------------------------------------------------------------- //
 
 void
-Compile::error_at_current(const std::string& msg)
+Compile::error_at_current(std::string_view msg)
 {
   error_at(current_, msg);
 }
@@ -49,7 +289,7 @@ Compile::error_at_current(const std::string& msg)
 // ---------------------------------------------------------------------------------------------- //
 
 void
-Compile::error_at_previous(const std::string& msg)
+Compile::error_at_previous(std::string_view msg)
 {
   error_at(previous_, msg);
 }
@@ -57,7 +297,7 @@ Compile::error_at_previous(const std::string& msg)
 // ---------------------------------------------------------------------------------------------- //
 
 void
-Compile::error_at(const Token& token, const std::string& msg)
+Compile::error_at(const Token& token, std::string_view msg)
 {
   if (panic_mode_)
   {
@@ -65,7 +305,8 @@ Compile::error_at(const Token& token, const std::string& msg)
   }
   panic_mode_ = true;
 
-  error_msg_ << fmt::format("[line {:d}]", token.line);
+  const auto [line, column] = scanner_.line_index()->location(token.offset);
+  error_msg_ << fmt::format("[line {:d}, column {:d}]", line, column);
   if (token.type == TokenType::eof)
   {
     error_msg_ << " at end";
@@ -100,12 +341,12 @@ Compile::advance()
       break;
     }
 
-    error_at_current(std::string{current_.token});
+    error_at_current(current_.token);
   }
 }
 
 void
-Compile::consume(TokenType type, const std::string& msg)
+Compile::consume(TokenType type, std::string_view msg)
 {
   if (current_.type == type)
   {
@@ -194,13 +435,13 @@ Compile::literal(CompileContext& cxt, CanAssign) // NOLINT(readability-make-memb
   switch (previous_.type)
   {
     case TokenType::false_:
-      emit(cxt, previous_.line, OpFalse{});
+      emit_constant(cxt, previous_.offset, false);
       break;
     case TokenType::true_:
-      emit(cxt, previous_.line, OpTrue{});
+      emit_constant(cxt, previous_.offset, true);
       break;
     case TokenType::nil:
-      emit(cxt, previous_.line, OpNil{});
+      emit_constant(cxt, previous_.offset, Nil{});
       break;
     default:
       __builtin_unreachable();
@@ -208,10 +449,18 @@ Compile::literal(CompileContext& cxt, CanAssign) // NOLINT(readability-make-memb
 }
 
 void
-Compile::number(CompileContext& cxt, CanAssign) // NOLINT(readability-make-member-function-const)
+Compile::number(CompileContext& cxt, CanAssign)
 {
-  const auto value = std::stod(previous_.token.data());
-  emit(cxt, previous_.line, OpConstant{cxt.chunk.code->add_constant(value)});
+  // The token is not null-terminated, and its syntax was checked by the scanner.
+  const auto token = previous_.token;
+  auto value = 0.0;
+  // NOLINTNEXTLINE(*-pointer-arithmetic)
+  if (std::from_chars(token.data(), token.data() + token.size(), value).ec != std::errc{})
+  {
+    error_at_previous("Number out of range");
+    return;
+  }
+  emit_constant(cxt, previous_.offset, value);
 }
 
 void
@@ -225,6 +474,7 @@ void
 Compile::unary(CompileContext& cxt, CanAssign)
 {
   const auto operator_type = previous_.type;
+  const auto operator_offset = previous_.offset;
 
   // Compile the operand.
   parse_precedence(cxt, Precedence::unary);
@@ -232,10 +482,10 @@ Compile::unary(CompileContext& cxt, CanAssign)
   switch (operator_type)
   {
     case TokenType::bang:
-      emit(cxt, previous_.line, OpNot{});
+      emit_operator(cxt, operator_offset, OpNot{});
       break;
     case TokenType::minus:
-      emit(cxt, previous_.line, OpNegate{});
+      emit_operator(cxt, operator_offset, OpNegate{});
       break;
     default:
       __builtin_unreachable();
@@ -246,40 +496,42 @@ void
 Compile::binary(CompileContext& cxt, CanAssign)
 {
   const auto operator_type = previous_.type;
+  // Errors are reported at the operator.
+  const auto operator_offset = previous_.offset;
   const auto rule = get_rule(operator_type);
   parse_precedence(cxt, rule.precedence);
 
   switch (operator_type)
   {
     case TokenType::plus:
-      emit(cxt, previous_.line, OpAdd{});
+      emit_operator(cxt, operator_offset, OpAdd{});
       break;
     case TokenType::minus:
-      emit(cxt, previous_.line, OpSubtract{});
+      emit_operator(cxt, operator_offset, OpSubtract{});
       break;
     case TokenType::star:
-      emit(cxt, previous_.line, OpMultiply{});
+      emit_operator(cxt, operator_offset, OpMultiply{});
       break;
     case TokenType::slash:
-      emit(cxt, previous_.line, OpDivide{});
+      emit_operator(cxt, operator_offset, OpDivide{});
       break;
     case TokenType::bang_equal:
-      emit(cxt, previous_.line, OpEqual{}, OpNot{});
+      emit_operator(cxt, operator_offset, OpEqual{}, OpNot{});
       break;
     case TokenType::equal_equal:
-      emit(cxt, previous_.line, OpEqual{});
+      emit_operator(cxt, operator_offset, OpEqual{});
       break;
     case TokenType::greater:
-      emit(cxt, previous_.line, OpGreater{});
+      emit_operator(cxt, operator_offset, OpGreater{});
       break;
     case TokenType::greater_equal:
-      emit(cxt, previous_.line, OpLess{}, OpNot{});
+      emit_operator(cxt, operator_offset, OpLess{}, OpNot{});
       break;
     case TokenType::less:
-      emit(cxt, previous_.line, OpLess{});
+      emit_operator(cxt, operator_offset, OpLess{});
       break;
     case TokenType::less_equal:
-      emit(cxt, previous_.line, OpGreater{}, OpNot{});
+      emit_operator(cxt, operator_offset, OpGreater{}, OpNot{});
       break;
     default:
       __builtin_unreachable();
@@ -289,8 +541,8 @@ Compile::binary(CompileContext& cxt, CanAssign)
 void
 Compile::string(CompileContext& cxt, CanAssign) // NOLINT(readability-make-member-function-const)
 {
-  const auto* obj = cxt.chunk.memory->make_string(std::string{previous_.token});
-  emit(cxt, previous_.line, OpConstant{cxt.chunk.code->add_constant(obj)});
+  const auto* obj = cxt.chunk.memory->make_string(previous_.token);
+  emit_constant(cxt, previous_.offset, obj);
 }
 
 void
@@ -335,17 +587,34 @@ Compile::named_variable(CompileContext& cxt,
                         Token token,
                         CanAssign can_assign) // NOLINT(readability-make-member-function-const)
 {
-  const auto var_name = std::string{token.token};
-  const auto index = cxt.chunk.memory->maybe_add_global_variable(var_name);
+  const auto index = cxt.chunk.memory->maybe_add_global_variable(token.token);
+
+  const auto defined = cxt.defined_globals.contains(index);
 
   if (can_assign == CanAssign::yes and match(TokenType::equal))
   {
     expression(cxt);
-    emit(cxt, previous_.line, OpSetGlobal{index});
+    if (defined)
+    {
+      emit_indexed<BasicOpSetGlobalUnchecked>(cxt, token.offset, index);
+    }
+    else
+    {
+      emit_indexed<BasicOpSetGlobal>(cxt, token.offset, index);
+    }
+  }
+  else if (const auto search = cxt.constant_globals.find(index);
+           search != cend(cxt.constant_globals))
+  {
+    emit_constant(cxt, token.offset, search->second);
+  }
+  else if (defined)
+  {
+    emit_indexed<BasicOpGetGlobalVarUnchecked>(cxt, token.offset, index);
   }
   else
   {
-    emit(cxt, previous_.line, OpGetGlobalVar{index});
+    emit_indexed<BasicOpGetGlobalVar>(cxt, token.offset, index);
   }
 }
 
@@ -356,7 +625,7 @@ Compile::print_statement(CompileContext& cxt)
 {
   expression(cxt);
   consume(TokenType::semicolon, "Expect ';' after expression.");
-  emit(cxt, previous_.line, OpPrint{});
+  emit(cxt, previous_.offset, OpPrint{});
 }
 
 void
@@ -364,13 +633,15 @@ Compile::expression_statement(CompileContext& cxt)
 {
   expression(cxt);
   consume(TokenType::semicolon, "Expect ';' after expression.");
-  emit(cxt, previous_.line, OpPop<1>{});
+  emit(cxt, previous_.offset, OpPop<1>{});
 }
 
 void
 Compile::var_declaration(CompileContext& cxt)
 {
   const auto var_index = parse_variable(cxt, "Expect variable name");
+  // Looked up now, as the token may not outlive the initializer.
+  const auto effectively_constant = cxt.effectively_constant_globals.contains(previous_.token);
 
   if (match(TokenType::equal))
   {
@@ -378,21 +649,26 @@ Compile::var_declaration(CompileContext& cxt)
   }
   else
   {
-    emit(cxt, previous_.line, OpNil{});
+    emit_constant(cxt, previous_.offset, Nil{});
   }
 
   consume(TokenType::semicolon, "Expect ';' after variable declaration");
 
-  emit(cxt, previous_.line, OpDefineGlobalVar{var_index});
+  // The initializer is a single constant if it's the last instruction.
+  if (not cxt.trailing_constants.empty() and effectively_constant)
+  {
+    cxt.constant_globals.insert_or_assign(var_index, cxt.trailing_constants.back().value);
+  }
+
+  emit_indexed<BasicOpDefineGlobalVar>(cxt, previous_.offset, var_index);
+  cxt.defined_globals.insert(var_index);
 }
 
 GlobalVariableIndex
-Compile::parse_variable(CompileContext& cxt, const std::string& error_msg)
+Compile::parse_variable(CompileContext& cxt, std::string_view error_msg)
 {
   consume(TokenType::identifier, error_msg);
-  const auto var_name = std::string{previous_.token};
-
-  return cxt.chunk.memory->maybe_add_global_variable(var_name);
+  return cxt.chunk.memory->maybe_add_global_variable(previous_.token);
 }
 
 // ---------------------------------------------------------------------------------------------- //
@@ -436,8 +712,20 @@ Compile::CompileResult
 Compile::operator()(std::shared_ptr<Memory> memory)
 {
   auto code = std::make_shared<Code>();
+  code->set_line_index(scanner_.line_index());
+  memory->add_code(code);
   auto cxt = CompileContext{Chunk{code, memory}};
 
+  if (optimize_ == opt_optimize::yes)
+  {
+    cxt.fold_constants = true;
+    // The source is scanned twice, which is not possible when it's streamed.
+    if (auto first_pass = scanner_.rescan())
+    {
+      cxt.effectively_constant_globals = find_effectively_constant_globals(std::move(*first_pass));
+    }
+  }
+
   advance();
 
   while (not match(TokenType::eof))
@@ -445,7 +733,7 @@ Compile::operator()(std::shared_ptr<Memory> memory)
     declaration(cxt);
   }
 
-  emit(cxt, previous_.line, OpReturn{});
+  emit(cxt, previous_.offset, OpReturn{});
 
   if (had_error_)
   {
@@ -453,7 +741,11 @@ Compile::operator()(std::shared_ptr<Memory> memory)
   }
   else
   {
-    return cxt.chunk;
+    if (optimize_ == opt_optimize::yes)
+    {
+      peephole(*cxt.chunk.code);
+    }
+    return verify(std::move(cxt.chunk));
   }
 }
 
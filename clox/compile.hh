@@ -3,6 +3,7 @@
 #include <array>
 #include <sstream>
 #include <string>
+#include <string_view>
 
 #include <boost/leaf.hpp>
 
@@ -19,14 +20,20 @@ class Compile
 public:
   using CompileResult = boost::leaf::result<Chunk>;
 
+  enum class opt_optimize
+  {
+    yes,
+    no
+  };
+
 public:
-  explicit Compile(Scanner&&);
+  explicit Compile(Scanner&&, opt_optimize optimize = opt_optimize::yes);
 
   CompileResult operator()(std::shared_ptr<Memory>);
 
 private:
   void advance();
-  void consume(TokenType, const std::string& error_msg);
+  void consume(TokenType, std::string_view error_msg);
   [[nodiscard]] bool match(TokenType);
   [[nodiscard]] bool check(TokenType) const noexcept;
   void synchronize();
@@ -49,17 +56,18 @@ private:
   void expression_statement(detail::CompileContext&);
 
   void var_declaration(detail::CompileContext&);
-  detail::GlobalVariableIndex parse_variable(detail::CompileContext&, const std::string& error_msg);
+  detail::GlobalVariableIndex parse_variable(detail::CompileContext&, std::string_view error_msg);
 
   [[nodiscard]] static constexpr const detail::ParseRule& get_rule(TokenType);
   void parse_precedence(detail::CompileContext&, detail::Precedence);
 
-  void error_at_current(const std::string&);
-  void error_at_previous(const std::string&);
-  void error_at(const Token& token, const std::string& msg);
+  void error_at_current(std::string_view);
+  void error_at_previous(std::string_view);
+  void error_at(const Token& token, std::string_view msg);
 
 private:
   Scanner scanner_;
+  opt_optimize optimize_;
   Token current_{};
   Token previous_{};
   bool had_error_{false};
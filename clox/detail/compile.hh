@@ -1,13 +1,20 @@
 #pragma once
 
 #include <array>
+#include <cassert>
+#include <cstdint>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <variant>
 #include <vector>
 
 #include <magic_enum.hpp>
 
 #include "clox/chunk.hh"
+#include "clox/detail/index.hh"
 #include "clox/detail/token.hh"
 #include "clox/scanner.hh"
 
@@ -28,6 +35,19 @@ struct Local
   std::size_t depth{};
 };
 
+// A constant loaded by one of the last instructions of the code, which can still be folded with
+// the operators which follow.
+struct TrailingConstant
+{
+  std::size_t code_size;
+  std::size_t nb_constants;
+  Value value;
+};
+
+// Constants are deduplicated: numbers are identified by their representation, so that 0 and -0
+// remain distinct, and strings by identity, as they are interned.
+using ConstantKey = std::variant<std::uint64_t, const ObjString*>;
+
 struct CompileContext
 {
   explicit CompileContext(Chunk&& chunk)
@@ -37,6 +57,19 @@ struct CompileContext
   Chunk chunk;
   std::vector<Local> locals{};
   std::size_t scope_depth{0};
+
+  // Indexes of the numbers and strings already in the constants of the code.
+  std::unordered_map<ConstantKey, ConstantIndex> constant_indexes{};
+
+  bool fold_constants{false};
+  std::vector<TrailingConstant> trailing_constants{};
+  // Global variables which are defined once and never assigned.
+  std::unordered_set<std::string_view> effectively_constant_globals{};
+  // Values of the above which were initialized with a constant.
+  std::unordered_map<GlobalVariableIndex, Value> constant_globals{};
+  // Global variables which are definitely defined at this point of the code. As there is no control
+  // flow yet, it's the case of all variables defined by a previous instruction of the chunk.
+  std::unordered_set<GlobalVariableIndex> defined_globals{};
 };
 
 // ---------------------------------------------------------------------------------------------- //
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "clox/detail/index.hh"
+#include "clox/value.hh"
+
+namespace clox::detail {
+
+// ---------------------------------------------------------------------------------------------- //
+
+// Values of global variables, indexed directly by the dense indexes given by Memory. Whether a
+// variable has been defined is kept in a separate bitset.
+class Globals
+{
+public:
+  // Make room for the variables known by Memory when a chunk is about to be executed. Existing
+  // variables keep their value.
+  void resize(std::size_t nb_global_variables)
+  {
+    values_.resize(nb_global_variables);
+    defined_.resize(nb_global_variables, false);
+  }
+
+  void define(GlobalVariableIndex index, Value value) noexcept
+  {
+    values_[slot(index)] = value;
+    defined_[slot(index)] = true;
+  }
+
+  // Return nullptr if the variable has not been defined yet.
+  [[nodiscard]] Value* find(GlobalVariableIndex index) noexcept
+  {
+    return defined_[slot(index)] ? &values_[slot(index)] : nullptr;
+  }
+
+  // Precondition: the variable has been defined.
+  [[nodiscard]] Value& operator[](GlobalVariableIndex index) noexcept
+  {
+    assert(defined_[slot(index)]);
+    return values_[slot(index)];
+  }
+
+  // Values of all variables, undefined ones being nil, to be marked by the garbage collector.
+  [[nodiscard]] std::span<const Value> values() const noexcept { return values_; }
+
+private:
+  [[nodiscard]] std::size_t slot(GlobalVariableIndex index) const noexcept
+  {
+    const auto slot = static_cast<std::uint32_t>(index);
+    assert(slot < values_.size());
+    return slot;
+  }
+
+private:
+  std::vector<Value> values_{};
+  std::vector<bool> defined_{};
+};
+
+// ---------------------------------------------------------------------------------------------- //
+
+} // namespace clox::detail
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+namespace clox::detail {
+
+// ---------------------------------------------------------------------------------------------- //
+
+// Fast non-cryptographic hash of a string, based on wyhash
+// (https://github.com/wangyi-fudan/wyhash). Long strings are consumed 48 bytes at a time by three
+// independent multiply-mix lanes.
+
+namespace hash_impl {
+
+__extension__ using uint128 = unsigned __int128;
+
+inline constexpr auto secret = std::to_array<std::uint64_t>(
+  {0x2d358dccaa6c78a5ULL, 0x8bb84b93962eacc9ULL, 0x4b33a62ed433d4a3ULL, 0x4d5a2da51de1aa47ULL});
+
+inline void
+mum(std::uint64_t& a, std::uint64_t& b) noexcept
+{
+  const auto r = static_cast<uint128>(a) * b;
+  a = static_cast<std::uint64_t>(r);
+  b = static_cast<std::uint64_t>(r >> 64U);
+}
+
+inline std::uint64_t
+mix(std::uint64_t a, std::uint64_t b) noexcept
+{
+  mum(a, b);
+  return a ^ b;
+}
+
+inline std::uint64_t
+read8(const char* p) noexcept
+{
+  auto v = std::uint64_t{};
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+inline std::uint64_t
+read4(const char* p) noexcept
+{
+  auto v = std::uint32_t{};
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+// Precondition: 0 < len <= 3.
+inline std::uint64_t
+read3(const char* p, std::size_t len) noexcept
+{
+  // NOLINTBEGIN(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+  return (static_cast<std::uint64_t>(static_cast<unsigned char>(p[0])) << 16U) |
+         (static_cast<std::uint64_t>(static_cast<unsigned char>(p[len >> 1U])) << 8U) |
+         static_cast<std::uint64_t>(static_cast<unsigned char>(p[len - 1]));
+  // NOLINTEND(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+}
+
+} // namespace hash_impl
+
+// NOLINTBEGIN(cppcoreguidelines-pro-bounds-pointer-arithmetic,readability-magic-numbers)
+[[nodiscard]] inline std::uint64_t
+hash(std::string_view str, std::uint64_t seed = 0) noexcept
+{
+  using namespace hash_impl;
+
+  const auto* p = str.data();
+  const auto len = str.size();
+  auto a = std::uint64_t{0};
+  auto b = std::uint64_t{0};
+
+  seed ^= mix(seed ^ secret[0], secret[1]);
+
+  if (len <= 16)
+  {
+    if (len >= 4)
+    {
+      const auto offset = (len >> 3U) << 2U;
+      a = (read4(p) << 32U) | read4(p + offset);
+      b = (read4(p + len - 4) << 32U) | read4(p + len - 4 - offset);
+    }
+    else if (len > 0)
+    {
+      a = read3(p, len);
+    }
+  }
+  else
+  {
+    auto remaining = len;
+    if (remaining > 48)
+    {
+      auto seed1 = seed;
+      auto seed2 = seed;
+      do
+      {
+        seed = mix(read8(p) ^ secret[1], read8(p + 8) ^ seed);
+        seed1 = mix(read8(p + 16) ^ secret[2], read8(p + 24) ^ seed1);
+        seed2 = mix(read8(p + 32) ^ secret[3], read8(p + 40) ^ seed2);
+        p += 48;
+        remaining -= 48;
+      } while (remaining > 48);
+      seed ^= seed1 ^ seed2;
+    }
+    while (remaining > 16)
+    {
+      seed = mix(read8(p) ^ secret[1], read8(p + 8) ^ seed);
+      p += 16;
+      remaining -= 16;
+    }
+    a = read8(p + remaining - 16);
+    b = read8(p + remaining - 8);
+  }
+
+  a ^= secret[1];
+  b ^= seed;
+  mum(a, b);
+  return mix(a ^ secret[0] ^ len, b ^ secret[1]);
+}
+// NOLINTEND(cppcoreguidelines-pro-bounds-pointer-arithmetic,readability-magic-numbers)
+
+// Hash of unordered containers keyed by strings, which can be looked up by views without building
+// a std::string. To be used with std::equal_to<>.
+struct StringHash
+{
+  using is_transparent = void;
+
+  [[nodiscard]] std::size_t operator()(std::string_view str) const noexcept { return hash(str); }
+};
+
+// ---------------------------------------------------------------------------------------------- //
+
+} // namespace clox::detail
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <cassert>
 #include <cstdint>
+#include <limits>
 
 #include <type_safe/strong_typedef.hpp>
 
@@ -8,7 +10,7 @@ namespace clox::detail {
 
 // ---------------------------------------------------------------------------------------------- //
 
-struct ConstantIndex : type_safe::strong_typedef<ConstantIndex, std::uint16_t>
+struct ConstantIndex : type_safe::strong_typedef<ConstantIndex, std::uint32_t>
 {
   using strong_typedef::strong_typedef;
 };
@@ -16,7 +18,7 @@ struct ConstantIndex : type_safe::strong_typedef<ConstantIndex, std::uint16_t>
 // ---------------------------------------------------------------------------------------------- //
 
 struct GlobalVariableIndex
-  : type_safe::strong_typedef<GlobalVariableIndex, std::uint16_t>
+  : type_safe::strong_typedef<GlobalVariableIndex, std::uint32_t>
   , type_safe::strong_typedef_op::equality_comparison<GlobalVariableIndex>
   , type_safe::strong_typedef_op::relational_comparison<GlobalVariableIndex>
   , type_safe::strong_typedef_op::integer_arithmetic<GlobalVariableIndex>
@@ -26,6 +28,54 @@ struct GlobalVariableIndex
 
 // ---------------------------------------------------------------------------------------------- //
 
+// Operand of the short form of an instruction, which holds an index in 16 bits. Instructions whose
+// index doesn't fit have a long form, with a full index as operand.
+template<typename Index>
+class ShortIndex
+{
+public:
+  [[nodiscard]] static constexpr bool fits(Index index) noexcept
+  {
+    return static_cast<std::uint32_t>(index) <= std::numeric_limits<std::uint16_t>::max();
+  }
+
+  // Precondition: fits(index).
+  // NOLINTNEXTLINE(hicpp-explicit-conversions)
+  constexpr ShortIndex(Index index) noexcept
+    : index_{static_cast<std::uint16_t>(static_cast<std::uint32_t>(index))}
+  {
+    assert(fits(index));
+  }
+
+  // NOLINTNEXTLINE(hicpp-explicit-conversions)
+  constexpr operator Index() const noexcept { return Index{index_}; }
+
+  constexpr explicit operator std::uint16_t() const noexcept { return index_; }
+
+private:
+  std::uint16_t index_;
+};
+
+using ShortConstantIndex = ShortIndex<ConstantIndex>;
+using ShortGlobalVariableIndex = ShortIndex<GlobalVariableIndex>;
+
+// Integer value of an index, whether it's the operand of a short or of a long instruction.
+template<typename Index>
+[[nodiscard]] constexpr std::uint32_t
+to_integer(Index index) noexcept
+{
+  return static_cast<std::uint32_t>(index);
+}
+
+template<typename Index>
+[[nodiscard]] constexpr std::uint32_t
+to_integer(ShortIndex<Index> index) noexcept
+{
+  return static_cast<std::uint16_t>(index);
+}
+
+// ---------------------------------------------------------------------------------------------- //
+
 } // namespace clox::detail
 
 // ---------------------------------------------------------------------------------------------- //
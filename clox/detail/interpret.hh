@@ -1,195 +1,266 @@
 #pragma once
 
-#include <exception>
-#include <iosfwd>
-#include <iterator>
+#include <string>
 #include <type_traits>
+#include <utility>
 
 #include <fmt/core.h>
 
 #include "clox/code.hh"
 #include "clox/detail/stack.hh"
-#include "clox/detail/visitor.hh"
 #include "clox/nil.hh"
 #include "clox/obj_string.hh"
 #include "clox/opcode.hh"
+#include "clox/output.hh"
 #include "clox/vm.hh"
 
 namespace clox::detail {
 
 // ---------------------------------------------------------------------------------------------- //
 
-struct InterpretReturn : public std::exception
+// Why the execution of a chunk stopped.
+struct Status
 {
-  explicit InterpretReturn(VMResultStatus status)
-    : InterpretReturn{status, {}}
-  {}
-
-  explicit InterpretReturn(VMResultStatus status, std::string msg)
-    : status{status}
-    , message{std::move(msg)}
-  {}
-
-  [[nodiscard]] const char* what() const noexcept override { return message.data(); }
-
-  VMResultStatus status;
-  std::string message;
+  VMResultStatus status{VMResultStatus::ok};
+  std::string message{};
 };
 
 // ---------------------------------------------------------------------------------------------- //
 
+// Execute instructions. Each operator returns true if the execution should continue with the next
+// instruction, false if it should stop, in which case the reason is stored in `status`.
 struct Dispatch
 {
   Chunk& chunk;
   VM& vm;
   Stack& stack;
-  std::ostream& os;
-  const Code::const_iterator current_ip;
+  Output& output;
+  Status& status;
+  // Used by the binary tracer only, to record offsets.
+  Code::const_iterator code_begin{};
 
-  template<typename Op>
-  void operator()(OpBinary<Op>) const
+  template<typename Impl>
+  [[nodiscard]] bool operator()(OpBinary<Impl>) const
   {
     const auto rhs = stack.pop();
-    const auto lhs = stack.top();
-    stack.top() = OpBinary<Op>{}(lhs, rhs);
+    return binary<Impl>(stack.top(), rhs);
   }
 
-  void operator()(OpAdd) const
+  template<typename Impl>
+  [[nodiscard]] bool operator()(OpBinaryConstant<Impl> op) const
   {
-    const auto rhs = stack.pop();
-    const auto lhs = stack.top();
+    return binary<Impl>(stack.top(), chunk.code->get_constant(op.constant));
+  }
 
-    const auto visitor = detail::visitor{
-      [&](double lhs, double rhs) { stack.top() = OpAdd{}(lhs, rhs); },
-      [&](const ObjString* lhs, const ObjString* rhs)
-      { stack.top() = chunk.memory->make_string(lhs->str + rhs->str); },
-      [](const auto&, const auto&) {
-        throw InterpretReturn{VMResultStatus::runtime_error, "Operands must be numbers or strings"};
-      }};
+  template<typename Impl>
+  [[nodiscard]] bool operator()(OpBinaryGlobal<Impl> op) const
+  {
+    const auto* value = vm.globals().find(op.global_variable_index);
+    if (value == nullptr) [[unlikely]]
+    {
+      return undefined_variable(op.global_variable_index);
+    }
+    return binary<Impl>(stack.top(), *value);
+  }
 
-    std::visit(visitor, lhs.value(), rhs.value());
+  template<typename Impl>
+  [[nodiscard]] bool operator()(OpBinaryGlobalUnchecked<Impl> op) const
+  {
+    return binary<Impl>(stack.top(), vm.globals()[op.global_variable_index]);
   }
 
-  void operator()(OpConstant op) const
+  template<typename Operand>
+  [[nodiscard]] bool operator()(BasicOpConstant<Operand> op) const
   {
-    const auto value = chunk.code->get_constant(op.constant);
-    stack.push(value);
+    stack.push(chunk.code->get_constant(op.constant));
+    return true;
   }
 
-  void operator()(OpDefineGlobalVar op) const
+  template<typename Operand>
+  [[nodiscard]] bool operator()(BasicOpDefineGlobalVar<Operand> op) const
   {
-    const auto var_value = stack.pop();
-    vm.globals().insert_or_assign(op.global_variable_index, var_value);
+    vm.globals().define(op.global_variable_index, stack.pop());
+    return true;
   }
 
-  void operator()(OpEqual) const
+  [[nodiscard]] bool operator()(OpEqual) const
   {
-    const auto rhs = stack.pop();
-    const auto lhs = stack.top();
-    stack.top() = (rhs == lhs);
+    const auto rhs = chunk.memory->intern(stack.pop());
+    stack.top() = (rhs == chunk.memory->intern(stack.top()));
+    return true;
   }
 
-  void operator()(OpFalse) const { stack.push(false); }
+  [[nodiscard]] bool operator()(OpFalse) const
+  {
+    stack.push(false);
+    return true;
+  }
 
-  void operator()(OpGetGlobalVar op) const
+  template<typename Operand>
+  [[nodiscard]] bool operator()(BasicOpGetGlobalVar<Operand> op) const
   {
-    if (const auto search = vm.globals().find(op.global_variable_index);
-        search == cend(vm.globals()))
+    const auto* value = vm.globals().find(op.global_variable_index);
+    if (value == nullptr) [[unlikely]]
     {
-      throw InterpretReturn{
-        VMResultStatus::runtime_error,
-        fmt::format("Undefined variable {}",
-                    chunk.memory->get_global_variable(op.global_variable_index))};
+      return undefined_variable(op.global_variable_index);
     }
-    else
+    stack.push(*value);
+    return true;
+  }
+
+  template<typename Operand>
+  [[nodiscard]] bool operator()(BasicOpGetGlobalVarUnchecked<Operand> op) const
+  {
+    stack.push(vm.globals()[op.global_variable_index]);
+    return true;
+  }
+
+  [[nodiscard]] bool operator()(OpNegate) const
+  {
+    auto& value = stack.top();
+    if (not value.is<double>()) [[unlikely]]
     {
-      stack.push(search->second);
+      return expected_number(value);
     }
+    value = -value.unchecked_as<double>();
+    return true;
   }
 
-  void operator()(OpNegate) const { stack.top() = -stack.top().as<double>(); }
-
-  void operator()(OpNil) const { stack.push(Nil{}); }
+  [[nodiscard]] bool operator()(OpNil) const
+  {
+    stack.push(Nil{});
+    return true;
+  }
 
-  void operator()(OpNot) const { stack.push(stack.pop().falsey()); }
+  [[nodiscard]] bool operator()(OpNot) const
+  {
+    stack.top() = stack.top().falsey();
+    return true;
+  }
 
   template<std::size_t N>
-  void operator()(OpPop<N>) const
+  [[nodiscard]] bool operator()(OpPop<N>) const
   {
     pop_and_discard(std::make_index_sequence<N>{});
+    return true;
   }
 
-  void operator()(OpPrint) const { os << stack.pop() << '\n'; }
+  // Ropes are printed without being flattened.
+  [[nodiscard]] bool operator()(OpPrint) const
+  {
+    output.print(stack.pop());
+    return true;
+  }
 
-  // NOLINTNEXTLINE(readability-convert-member-functions-to-static)
-  [[noreturn]] Code::const_iterator operator()(OpReturn) const
+  [[nodiscard]] bool operator()(OpReturn) const
   {
-    throw InterpretReturn{VMResultStatus::ok};
+    status.status = VMResultStatus::ok;
+    return false;
   }
 
-  void operator()(OpSetGlobal op) const
+  template<typename Operand>
+  [[nodiscard]] bool operator()(BasicOpSetGlobal<Operand> op) const
   {
-    if (auto search = vm.globals().find(op.global_variable_index); search == cend(vm.globals()))
+    auto* value = vm.globals().find(op.global_variable_index);
+    if (value == nullptr) [[unlikely]]
     {
-      throw InterpretReturn{
-        VMResultStatus::runtime_error,
-        fmt::format("Undefined variable {}",
-                    chunk.memory->get_global_variable(op.global_variable_index))};
+      return undefined_variable(op.global_variable_index);
+    }
+    *value = stack.top();
+    return true;
+  }
+
+  template<typename Operand>
+  [[nodiscard]] bool operator()(BasicOpSetGlobalUnchecked<Operand> op) const
+  {
+    vm.globals()[op.global_variable_index] = stack.top();
+    return true;
+  }
+
+  [[nodiscard]] bool operator()(OpTrue) const
+  {
+    stack.push(true);
+    return true;
+  }
+
+private:
+  // Compute `lhs = lhs op rhs`.
+  template<typename Impl>
+  [[nodiscard]] bool binary(Value& lhs, Value rhs) const
+  {
+    if constexpr (std::is_invocable_v<Impl, Value, Value>)
+    {
+      // Ropes are compared by identity once interned.
+      lhs = Impl{}(chunk.memory->intern(lhs), chunk.memory->intern(rhs));
     }
     else
     {
-      search->second = stack.top();
+      if (lhs.is<double>() and rhs.is<double>()) [[likely]]
+      {
+        lhs = Impl{}(lhs.unchecked_as<double>(), rhs.unchecked_as<double>());
+      }
+      else if constexpr (std::is_same_v<Impl, OpAddImpl>)
+      {
+        if (lhs.is_string() and rhs.is_string())
+        {
+          // Long strings are not copied, so that building a string by repeated concatenations
+          // takes linear time.
+          lhs = chunk.memory->concatenate(lhs, rhs);
+          // The result is on the stack, where it's a root.
+          maybe_collect_garbage();
+        }
+        else [[unlikely]]
+        {
+          return runtime_error("Operands must be numbers or strings");
+        }
+      }
+      else [[unlikely]]
+      {
+        return expected_number(lhs.is<double>() ? rhs : lhs);
+      }
     }
-  }
 
-  void operator()(OpTrue) const { stack.push(true); }
+    return true;
+  }
 
-private:
   template<std::size_t... indexes>
   void pop_and_discard(std::integer_sequence<std::size_t, indexes...>) const
   {
     // Call pop_and_discard as many times as there are indexes in the integer_sequence.
     (..., [this](auto /* ignore index */) { stack.pop_and_discard(); }(indexes));
   }
-};
-
-struct Interpret
-{
-  Chunk& chunk;
-  VM& vm;
-  detail::Stack& stack;
-  std::ostream& os;
-  const Code::const_iterator current_ip;
 
-  template<typename T>
-  [[nodiscard]] Code::const_iterator operator()(const T& x) const
+  void maybe_collect_garbage() const
   {
-    static constexpr auto op_modifies_current_ip =
-      std::is_same<std::invoke_result_t<Dispatch, T>, Code::const_iterator>::value;
-
-    if constexpr (op_modifies_current_ip)
-    {
-      return Dispatch{chunk, vm, stack, os, current_ip}(x);
-    }
-    else
+    if (chunk.memory->should_collect()) [[unlikely]]
     {
-      Dispatch{chunk, vm, stack, os, current_ip}(x);
-      return std::next(current_ip);
+      collect_garbage();
     }
   }
 
-  [[nodiscard]] Code::const_iterator visit() const
+  [[gnu::cold, gnu::noinline]] void collect_garbage() const
   {
-    try
-    {
-      return std::visit(Interpret{chunk, vm, stack, os, current_ip}, *current_ip);
-    }
-    catch (const BadValueAccess& e)
-    {
-      const auto message =
-        fmt::format("Bad type access: expected {}, got {}", e.expected_type, e.held_type);
-      throw InterpretReturn{VMResultStatus::runtime_error, message};
-    }
+    chunk.memory->collect({stack.values(), vm.globals().values()});
+  }
+
+  // Errors are reported out of the hot path.
+
+  [[gnu::cold, gnu::noinline]] bool runtime_error(std::string message) const
+  {
+    status.status = VMResultStatus::runtime_error;
+    status.message = std::move(message);
+    return false;
+  }
+
+  [[gnu::cold, gnu::noinline]] bool expected_number(const Value& value) const
+  {
+    return runtime_error(fmt::format("Bad type access: expected number, got {}", value.type()));
+  }
+
+  [[gnu::cold, gnu::noinline]] bool undefined_variable(GlobalVariableIndex index) const
+  {
+    return runtime_error(
+      fmt::format("Undefined variable {}", chunk.memory->get_global_variable(index)));
   }
 };
 
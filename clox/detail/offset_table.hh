@@ -0,0 +1,104 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace clox::detail {
+
+// ---------------------------------------------------------------------------------------------- //
+
+// Offsets in the source of the bytecode of a Code, run-length encoded: consecutive bytes from the
+// same token share a single entry. Offsets are only needed to report errors and to disassemble, so
+// the lookup is a binary search.
+class OffsetTable
+{
+public:
+  struct Run
+  {
+    // Offset of the first byte of the run in the bytecode.
+    std::uint32_t offset;
+    std::uint32_t source_offset;
+  };
+
+public:
+  OffsetTable() = default;
+
+  // Restore a table from the runs of another one, covering `size` bytes.
+  // Precondition: runs are sorted by offset, the first one starts at 0 and all start before `size`.
+  OffsetTable(std::vector<Run> runs, std::size_t size)
+    : runs_{std::move(runs)}
+    , size_{size}
+  {
+    assert(runs_.empty() ? size_ == 0 : runs_.front().offset == 0 and runs_.back().offset < size_);
+  }
+
+  // Append `size` bytes of bytecode compiled from the token at `source_offset`.
+  void add(std::size_t size, std::optional<std::size_t> source_offset)
+  {
+    const auto encoded = encode(source_offset);
+    if (runs_.empty() or runs_.back().source_offset != encoded)
+    {
+      runs_.push_back({static_cast<std::uint32_t>(size_), encoded});
+    }
+    size_ += size;
+  }
+
+  // Precondition: offset < size().
+  [[nodiscard]] std::optional<std::size_t> source_offset(std::size_t offset) const noexcept
+  {
+    assert(offset < size_);
+    // The first run which starts after `offset` follows the one containing it.
+    const auto after = std::ranges::upper_bound(runs_, offset, {}, &Run::offset);
+    return decode(std::prev(after)->source_offset);
+  }
+
+  // Keep the offsets of the first `size` bytes only.
+  void truncate(std::size_t size)
+  {
+    assert(size <= size_);
+    const auto after = std::ranges::lower_bound(runs_, size, {}, &Run::offset);
+    runs_.erase(after, runs_.end());
+    size_ = size;
+  }
+
+  void clear() noexcept
+  {
+    runs_.clear();
+    size_ = 0;
+  }
+
+  // Number of bytes of bytecode.
+  [[nodiscard]] std::size_t size() const noexcept { return size_; }
+
+  [[nodiscard]] std::size_t nb_runs() const noexcept { return runs_.size(); }
+
+  [[nodiscard]] std::span<const Run> runs() const noexcept { return runs_; }
+
+private:
+  static constexpr std::uint32_t no_offset = std::numeric_limits<std::uint32_t>::max();
+
+  [[nodiscard]] static std::uint32_t encode(std::optional<std::size_t> source_offset) noexcept
+  {
+    return source_offset ? static_cast<std::uint32_t>(*source_offset) : no_offset;
+  }
+
+  [[nodiscard]] static std::optional<std::size_t> decode(std::uint32_t source_offset) noexcept
+  {
+    return source_offset == no_offset ? std::nullopt : std::optional<std::size_t>{source_offset};
+  }
+
+private:
+  std::vector<Run> runs_{};
+  std::size_t size_{0};
+};
+
+// ---------------------------------------------------------------------------------------------- //
+
+} // namespace clox::detail
@@ -0,0 +1,250 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Select the instructions used to scan runs of characters. AVX2 is used when the compiler targets
+// it (e.g. with -march=native), SSE2 is always available on x86-64. Define CLOX_SCAN_SIMD to 0 to
+// scan one character at a time.
+#ifndef CLOX_SCAN_SIMD
+#if defined(__AVX2__) || defined(__SSE2__)
+#define CLOX_SCAN_SIMD 1
+#else
+#define CLOX_SCAN_SIMD 0
+#endif
+#endif
+
+namespace clox::detail {
+
+// ---------------------------------------------------------------------------------------------- //
+
+// Classes of characters of the scanner, and functions which find the end of runs of characters in
+// [first, last). Runs are scanned a block of 16 or 32 characters at a time when SIMD instructions
+// are available, and one character at a time otherwise or near `last`.
+
+[[nodiscard]] constexpr bool
+is_digit(char c) noexcept
+{
+  return c >= '0' and c <= '9';
+}
+
+[[nodiscard]] constexpr bool
+is_alpha(char c) noexcept
+{
+  return (c >= 'a' and c <= 'z') or (c >= 'A' and c <= 'Z') or c == '_';
+}
+
+// Newlines are skipped like other whitespaces: lines are computed from offsets when needed.
+[[nodiscard]] constexpr bool
+is_blank(char c) noexcept
+{
+  return c == ' ' or c == '\t' or c == '\r' or c == '\n';
+}
+
+namespace scan_impl {
+
+#if CLOX_SCAN_SIMD
+
+#if defined(__AVX2__)
+using Block = __m256i;
+
+[[nodiscard]] inline Block
+load(const char* p) noexcept
+{
+  return _mm256_loadu_si256(reinterpret_cast<const Block*>(p)); // NOLINT(*-reinterpret-cast)
+}
+
+[[nodiscard]] inline Block
+splat(char c) noexcept
+{
+  return _mm256_set1_epi8(c);
+}
+
+[[nodiscard]] inline Block
+equal(Block block, char c) noexcept
+{
+  return _mm256_cmpeq_epi8(block, splat(c));
+}
+
+// Characters are signed: those above 127 are in no range.
+[[nodiscard]] inline Block
+in_range(Block block, char low, char high) noexcept
+{
+  return _mm256_and_si256(_mm256_cmpgt_epi8(block, splat(static_cast<char>(low - 1))),
+                          _mm256_cmpgt_epi8(splat(static_cast<char>(high + 1)), block));
+}
+
+[[nodiscard]] inline Block
+either(Block lhs, Block rhs) noexcept
+{
+  return _mm256_or_si256(lhs, rhs);
+}
+
+// One bit per character, set if the character is in the class.
+[[nodiscard]] inline std::uint32_t
+bits(Block block) noexcept
+{
+  return static_cast<std::uint32_t>(_mm256_movemask_epi8(block));
+}
+#else
+using Block = __m128i;
+
+[[nodiscard]] inline Block
+load(const char* p) noexcept
+{
+  return _mm_loadu_si128(reinterpret_cast<const Block*>(p)); // NOLINT(*-reinterpret-cast)
+}
+
+[[nodiscard]] inline Block
+splat(char c) noexcept
+{
+  return _mm_set1_epi8(c);
+}
+
+[[nodiscard]] inline Block
+equal(Block block, char c) noexcept
+{
+  return _mm_cmpeq_epi8(block, splat(c));
+}
+
+// Characters are signed: those above 127 are in no range.
+[[nodiscard]] inline Block
+in_range(Block block, char low, char high) noexcept
+{
+  return _mm_and_si128(_mm_cmpgt_epi8(block, splat(static_cast<char>(low - 1))),
+                       _mm_cmplt_epi8(block, splat(static_cast<char>(high + 1))));
+}
+
+[[nodiscard]] inline Block
+either(Block lhs, Block rhs) noexcept
+{
+  return _mm_or_si128(lhs, rhs);
+}
+
+// One bit per character, set if the character is in the class.
+[[nodiscard]] inline std::uint32_t
+bits(Block block) noexcept
+{
+  return static_cast<std::uint32_t>(_mm_movemask_epi8(block));
+}
+#endif
+
+constexpr auto block_size = static_cast<std::ptrdiff_t>(sizeof(Block));
+constexpr auto all_bits = static_cast<std::uint32_t>((std::uint64_t{1} << sizeof(Block)) - 1);
+
+#endif
+
+struct Blank
+{
+  [[nodiscard]] static bool in(char c) noexcept { return is_blank(c); }
+#if CLOX_SCAN_SIMD
+  [[nodiscard]] static Block in(Block b) noexcept
+  {
+    return either(either(equal(b, ' '), equal(b, '\t')), either(equal(b, '\r'), equal(b, '\n')));
+  }
+#endif
+};
+
+struct Digit
+{
+  [[nodiscard]] static bool in(char c) noexcept { return is_digit(c); }
+#if CLOX_SCAN_SIMD
+  [[nodiscard]] static Block in(Block b) noexcept { return in_range(b, '0', '9'); }
+#endif
+};
+
+struct IdentifierCharacter
+{
+  [[nodiscard]] static bool in(char c) noexcept { return is_alpha(c) or is_digit(c); }
+#if CLOX_SCAN_SIMD
+  [[nodiscard]] static Block in(Block b) noexcept
+  {
+    return either(either(in_range(b, 'a', 'z'), in_range(b, 'A', 'Z')),
+                  either(in_range(b, '0', '9'), equal(b, '_')));
+  }
+#endif
+};
+
+// NOLINTBEGIN(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+template<typename Class>
+[[nodiscard]] const char*
+skip(const char* first, const char* last) noexcept
+{
+#if CLOX_SCAN_SIMD
+  for (; last - first >= block_size; first += block_size)
+  {
+    if (const auto outside = ~bits(Class::in(load(first))) & all_bits; outside != 0)
+    {
+      return first + std::countr_zero(outside);
+    }
+  }
+#endif
+  while (first != last and Class::in(*first))
+  {
+    ++first;
+  }
+  return first;
+}
+// NOLINTEND(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+
+} // namespace scan_impl
+
+// ---------------------------------------------------------------------------------------------- //
+
+[[nodiscard]] inline const char*
+skip_blanks(const char* first, const char* last) noexcept
+{
+  return scan_impl::skip<scan_impl::Blank>(first, last);
+}
+
+[[nodiscard]] inline const char*
+skip_digits(const char* first, const char* last) noexcept
+{
+  return scan_impl::skip<scan_impl::Digit>(first, last);
+}
+
+[[nodiscard]] inline const char*
+skip_identifier(const char* first, const char* last) noexcept
+{
+  return scan_impl::skip<scan_impl::IdentifierCharacter>(first, last);
+}
+
+// Return `last` if `c` is not in [first, last). memchr() is vectorized by the C library.
+[[nodiscard]] inline const char*
+find(const char* first, const char* last, char c) noexcept
+{
+  const auto* found = std::memchr(first, c, static_cast<std::size_t>(last - first));
+  return found != nullptr ? static_cast<const char*>(found) : last;
+}
+
+// NOLINTBEGIN(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+[[nodiscard]] inline std::size_t
+count_newlines(const char* first, const char* last) noexcept
+{
+  auto nb = std::size_t{0};
+#if CLOX_SCAN_SIMD
+  for (; last - first >= scan_impl::block_size; first += scan_impl::block_size)
+  {
+    nb += static_cast<std::size_t>(
+      std::popcount(scan_impl::bits(scan_impl::equal(scan_impl::load(first), '\n'))));
+  }
+#endif
+  for (; first != last; ++first)
+  {
+    nb += *first == '\n' ? 1 : 0;
+  }
+  return nb;
+}
+// NOLINTEND(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+
+// ---------------------------------------------------------------------------------------------- //
+
+} // namespace clox::detail
@@ -1,6 +1,9 @@
 #pragma once
 
-#include <vector>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <span>
 
 #include "clox/value.hh"
 
@@ -8,28 +11,65 @@ namespace clox::detail {
 
 // ---------------------------------------------------------------------------------------------- //
 
+// A stack with a fixed capacity. As the maximal depth of the stack is computed when the bytecode is
+// verified, there are no bounds checks, except for assertions in debug builds.
 class Stack
 {
-  static constexpr auto initial_stack_size = 1024;
-
 public:
-  Stack() { stack_.reserve(initial_stack_size); }
+  explicit Stack(std::size_t capacity)
+    : stack_{std::make_unique<Value[]>(capacity)} // NOLINT(*-avoid-c-arrays)
+    , top_{stack_.get()}
+#ifndef NDEBUG
+    , end_{stack_.get() + capacity}
+#endif
+  {}
+
+  // NOLINTBEGIN(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+
+  void push(Value value) noexcept
+  {
+    assert(top_ != end_);
+    *top_ = value;
+    ++top_;
+  }
+
+  [[nodiscard]] Value pop() noexcept
+  {
+    assert(top_ != stack_.get());
+    --top_;
+    return *top_;
+  }
 
-  void push(Value value) { stack_.push_back(value); }
+  void pop_and_discard() noexcept { [[maybe_unused]] const auto _ = pop(); }
 
-  [[nodiscard]] Value pop()
+  [[nodiscard]] const Value& top() const noexcept
   {
-    const auto value = stack_.back();
-    stack_.pop_back();
-    return value;
+    assert(top_ != stack_.get());
+    return *(top_ - 1);
   }
-  void pop_and_discard() { [[maybe_unused]] const auto _ = pop(); }
 
-  [[nodiscard]] const Value& top() const { return stack_.back(); }
-  [[nodiscard]] Value& top() { return stack_.back(); }
+  [[nodiscard]] Value& top() noexcept
+  {
+    assert(top_ != stack_.get());
+    return *(top_ - 1);
+  }
+
+  [[nodiscard]] std::size_t size() const noexcept
+  {
+    return static_cast<std::size_t>(top_ - stack_.get());
+  }
+
+  // NOLINTEND(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+
+  // Values from the bottom to the top of the stack.
+  [[nodiscard]] std::span<const Value> values() const noexcept { return {stack_.get(), size()}; }
 
 private:
-  std::vector<Value> stack_{};
+  std::unique_ptr<Value[]> stack_; // NOLINT(*-avoid-c-arrays)
+  Value* top_;
+#ifndef NDEBUG
+  Value* end_;
+#endif
 };
 
 // ---------------------------------------------------------------------------------------------- //
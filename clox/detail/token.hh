@@ -1,5 +1,8 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <limits>
 #include <string_view>
 
 namespace clox {
@@ -57,18 +60,24 @@ enum class TokenType
 
 // ---------------------------------------------------------------------------------------------- //
 
+// Offsets in a source are stored on 32 bits: the scanner reports an error past this one.
+inline constexpr std::size_t max_source_offset = std::numeric_limits<std::uint32_t>::max();
+
+// Tokens don't know their line: it's computed from their offset in the source by a LineIndex, and
+// only when it's needed. Sources are limited to 4 GiB.
 struct Token
 {
   Token() = default;
-  Token(TokenType type, std::string_view token, std::size_t line)
+  Token(TokenType type, std::string_view token, std::size_t offset)
     : type{type}
+    , offset{static_cast<std::uint32_t>(offset)}
     , token{token}
-    , line{line}
   {}
 
   TokenType type{TokenType::error};
+  // Of the first character of the token, which is the opening quote of a string.
+  std::uint32_t offset{};
   std::string_view token{};
-  std::size_t line{};
 };
 
 // ---------------------------------------------------------------------------------------------- //
@@ -11,8 +11,8 @@ disassemble(Code::const_iterator opcode_cit, const Chunk& chunk)
 {
   return fmt::format("{:04d} | {:04d} | {}",
                      chunk.code->code_offset(opcode_cit),
-                     chunk.code->line(opcode_cit).value_or(0),
-                     disassemble_opcode(*opcode_cit, chunk));
+                     chunk.code->location(opcode_cit).value_or(SourceLocation{0, 0}).line,
+                     disassemble_opcode(Code::decode(opcode_cit), chunk));
 }
 
 // ---------------------------------------------------------------------------------------------- //
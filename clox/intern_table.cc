@@ -0,0 +1,155 @@
+#include <algorithm>
+#include <ostream>
+#include <utility>
+
+#include <fmt/core.h>
+
+#include "clox/intern_table.hh"
+
+namespace clox {
+
+// ---------------------------------------------------------------------------------------------- //
+
+InternTable::InternTable()
+  : buckets_(initial_nb_buckets, nullptr)
+{}
+
+// ---------------------------------------------------------------------------------------------- //
+
+ObjString*
+InternTable::find(std::string_view str, std::uint64_t hash) const noexcept
+{
+  if (auto* obj = find(buckets_, str, hash))
+  {
+    return obj;
+  }
+  return rehashing() ? find(old_buckets_, str, hash) : nullptr;
+}
+
+ObjString*
+InternTable::find(const Buckets& buckets, std::string_view str, std::uint64_t hash) noexcept
+{
+  // The number of buckets is always a power of 2.
+  for (auto* obj = buckets[hash & (buckets.size() - 1)]; obj != nullptr; obj = obj->next_in_bucket_)
+  {
+    if (obj->hash == hash and obj->str() == str)
+    {
+      return obj;
+    }
+  }
+  return nullptr;
+}
+
+// ---------------------------------------------------------------------------------------------- //
+
+void
+InternTable::insert(ObjString& obj)
+{
+  if (rehashing())
+  {
+    rehash(rehash_step);
+  }
+  else if (size_ >= buckets_.size())
+  {
+    old_buckets_ = std::exchange(buckets_, Buckets(2 * buckets_.size(), nullptr));
+    next_old_bucket_ = 0;
+    rehash(rehash_step);
+  }
+
+  push(buckets_, obj);
+  ++size_;
+}
+
+void
+InternTable::push(Buckets& buckets, ObjString& obj) noexcept
+{
+  auto& head = buckets[obj.hash & (buckets.size() - 1)];
+  obj.next_in_bucket_ = head;
+  head = &obj;
+}
+
+// ---------------------------------------------------------------------------------------------- //
+
+bool
+InternTable::rehashing() const noexcept
+{
+  return not old_buckets_.empty();
+}
+
+void
+InternTable::rehash(std::size_t nb_buckets)
+{
+  const auto last = std::min(next_old_bucket_ + nb_buckets, old_buckets_.size());
+  for (; next_old_bucket_ < last; ++next_old_bucket_)
+  {
+    auto* obj = std::exchange(old_buckets_[next_old_bucket_], nullptr);
+    while (obj != nullptr)
+    {
+      auto* next = obj->next_in_bucket_;
+      push(buckets_, *obj);
+      obj = next;
+    }
+  }
+
+  if (next_old_bucket_ == old_buckets_.size())
+  {
+    old_buckets_ = Buckets{};
+  }
+}
+
+// ---------------------------------------------------------------------------------------------- //
+
+std::size_t
+InternTable::size() const noexcept
+{
+  return size_;
+}
+
+InternTable::Stats
+InternTable::stats() const
+{
+  auto max_chain_length = std::size_t{0};
+  auto nb_non_empty_buckets = std::size_t{0};
+
+  for (const auto* buckets : {&buckets_, &old_buckets_})
+  {
+    for (const auto* obj : *buckets)
+    {
+      auto length = std::size_t{0};
+      for (; obj != nullptr; obj = obj->next_in_bucket_)
+      {
+        ++length;
+      }
+      max_chain_length = std::max(max_chain_length, length);
+      nb_non_empty_buckets += length > 0 ? 1 : 0;
+    }
+  }
+
+  return {
+    .nb_strings = size_,
+    .nb_buckets = buckets_.size(),
+    .load_factor = static_cast<double>(size_) / static_cast<double>(buckets_.size()),
+    .max_chain_length = max_chain_length,
+    .mean_chain_length = nb_non_empty_buckets == 0 ? 0.0
+                                                   : static_cast<double>(size_) /
+                                                       static_cast<double>(nb_non_empty_buckets),
+    .rehashing = rehashing(),
+  };
+}
+
+std::ostream&
+operator<<(std::ostream& os, const InternTable::Stats& stats)
+{
+  return os << fmt::format("{} strings in {} buckets (load factor {:.2f}), chain length: max {}, "
+                           "mean {:.2f}{}",
+                           stats.nb_strings,
+                           stats.nb_buckets,
+                           stats.load_factor,
+                           stats.max_chain_length,
+                           stats.mean_chain_length,
+                           stats.rehashing ? ", rehashing" : "");
+}
+
+// ---------------------------------------------------------------------------------------------- //
+
+} // namespace clox
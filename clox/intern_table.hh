@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string_view>
+#include <vector>
+
+#include "clox/obj_string.hh"
+
+namespace clox {
+
+// ---------------------------------------------------------------------------------------------- //
+
+// Set of interned strings, chained through ObjString. The table doubles its number of buckets when
+// its load factor exceeds 1. Strings are then moved to the new buckets a few buckets at a time on
+// each insertion, so that no insertion has to rehash the whole table.
+class InternTable
+{
+public:
+  struct Stats
+  {
+    std::size_t nb_strings;
+    std::size_t nb_buckets;
+    double load_factor;
+    std::size_t max_chain_length;
+    // Among non-empty buckets.
+    double mean_chain_length;
+    bool rehashing;
+  };
+
+public:
+  InternTable();
+
+  // Return nullptr if there is no string equal to `str`, whose hash is `hash`.
+  [[nodiscard]] ObjString* find(std::string_view str, std::uint64_t hash) const noexcept;
+
+  // Precondition: there is no string equal to `obj` in the table.
+  void insert(ObjString& obj);
+
+  // Unlink the strings for which `pred` returns true and pass them to `dispose`. As entries are
+  // weak, this is how strings which are no longer referenced leave the table.
+  template<typename Pred, typename Dispose>
+  void erase_if(Pred&& pred, Dispose&& dispose)
+  {
+    for (auto* buckets : {&buckets_, &old_buckets_})
+    {
+      for (auto*& head : *buckets)
+      {
+        for (auto** link = &head; *link != nullptr;)
+        {
+          auto* obj = *link;
+          if (pred(*obj))
+          {
+            *link = obj->next_in_bucket_;
+            --size_;
+            dispose(obj);
+          }
+          else
+          {
+            link = &obj->next_in_bucket_;
+          }
+        }
+      }
+    }
+  }
+
+  [[nodiscard]] std::size_t size() const noexcept;
+  [[nodiscard]] Stats stats() const;
+
+private:
+  using Buckets = std::vector<ObjString*>;
+
+  static constexpr std::size_t initial_nb_buckets = 64;
+  // Number of buckets of the old table moved to the new one on each insertion.
+  static constexpr std::size_t rehash_step = 4;
+
+  [[nodiscard]] bool rehashing() const noexcept;
+  void rehash(std::size_t nb_buckets);
+  static void push(Buckets&, ObjString&) noexcept;
+  [[nodiscard]] static ObjString* find(const Buckets&, std::string_view, std::uint64_t) noexcept;
+
+private:
+  Buckets buckets_;
+  // Buckets before the last growth, which are not empty while rehashing.
+  Buckets old_buckets_{};
+  std::size_t next_old_bucket_{0};
+  std::size_t size_{0};
+};
+
+std::ostream&
+operator<<(std::ostream&, const InternTable::Stats&);
+
+// ---------------------------------------------------------------------------------------------- //
+
+} // namespace clox
@@ -0,0 +1,79 @@
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <utility>
+
+#include "clox/detail/scan.hh"
+#include "clox/detail/token.hh"
+#include "clox/line_index.hh"
+
+namespace clox {
+
+// ---------------------------------------------------------------------------------------------- //
+
+LineIndex::LineIndex(std::string_view source) noexcept
+  : pending_{source}
+{}
+
+// ---------------------------------------------------------------------------------------------- //
+
+void
+LineIndex::add(std::string_view bytes)
+{
+  index(bytes);
+}
+
+SourceLocation
+LineIndex::location(std::size_t offset) const
+{
+  build();
+  assert(offset <= size_);
+  // The first line which starts after `offset` follows the one containing it.
+  const auto after = std::ranges::upper_bound(line_starts_, offset);
+  const auto line = static_cast<std::size_t>(std::distance(line_starts_.begin(), after));
+  return {line, offset - *std::prev(after) + 1};
+}
+
+std::size_t
+LineIndex::nb_lines() const
+{
+  build();
+  return line_starts_.size();
+}
+
+// ---------------------------------------------------------------------------------------------- //
+
+void
+LineIndex::build() const
+{
+  if (not pending_.empty())
+  {
+    index(std::exchange(pending_, {}));
+  }
+}
+
+void
+LineIndex::index(std::string_view bytes) const
+{
+  const auto* first = bytes.data();
+  const auto* last = bytes.data() + bytes.size(); // NOLINT(*-pointer-arithmetic)
+
+  // Newlines are counted a block at a time, so that the offsets are stored without reallocations.
+  line_starts_.reserve(line_starts_.size() + detail::count_newlines(first, last));
+  for (const auto* newline = detail::find(first, last, '\n'); newline != last;
+       newline = detail::find(std::next(newline), last, '\n'))
+  {
+    const auto line_start = size_ + static_cast<std::size_t>(newline - first) + 1;
+    if (line_start > max_source_offset)
+    {
+      // No token is located past the limit.
+      break;
+    }
+    line_starts_.push_back(static_cast<std::uint32_t>(line_start));
+  }
+  size_ += bytes.size();
+}
+
+// ---------------------------------------------------------------------------------------------- //
+
+} // namespace clox
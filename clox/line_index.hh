@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace clox {
+
+// ---------------------------------------------------------------------------------------------- //
+
+// Where a byte of a source is, counted from 1.
+struct SourceLocation
+{
+  std::size_t line;
+  std::size_t column;
+
+  friend bool operator==(const SourceLocation&, const SourceLocation&) = default;
+};
+
+// ---------------------------------------------------------------------------------------------- //
+
+// Tokens and instructions only know the offset in their source of the characters they come from.
+// Their lines and columns are computed from the offsets of the starts of lines, which are indexed
+// when first needed, i.e. when an error is reported or when code is disassembled.
+class LineIndex
+{
+public:
+  // Index of a streamed source, extended by add() as the source is read.
+  LineIndex() = default;
+
+  // Index of a whole source held in memory, built on the first lookup. The source must outlive the
+  // index until then. Lookups are not thread-safe until the index is built.
+  explicit LineIndex(std::string_view source) noexcept;
+
+  // Index the next bytes of a streamed source.
+  void add(std::string_view bytes);
+
+  // Precondition: offset <= size of the source.
+  [[nodiscard]] SourceLocation location(std::size_t offset) const;
+
+  [[nodiscard]] std::size_t nb_lines() const;
+
+private:
+  void build() const;
+  void index(std::string_view bytes) const;
+
+private:
+  // Part of the source which is not indexed yet.
+  mutable std::string_view pending_{};
+  // Offset of the first byte of each line.
+  mutable std::vector<std::uint32_t> line_starts_{0};
+  // Number of indexed bytes.
+  mutable std::size_t size_{0};
+};
+
+// ---------------------------------------------------------------------------------------------- //
+
+} // namespace clox
@@ -0,0 +1,109 @@
+#include <cerrno>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "clox/mapped_file.hh"
+
+namespace clox {
+
+// ---------------------------------------------------------------------------------------------- //
+
+namespace /* anonymous */ {
+
+[[noreturn]] void
+throw_system_error(const std::filesystem::path& path)
+{
+  throw std::system_error{errno, std::generic_category(), path.string()};
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------------------------- //
+
+MappedFile::MappedFile(const std::filesystem::path& path)
+{
+  const auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC); // NOLINT(*-vararg)
+  if (fd < 0)
+  {
+    throw_system_error(path);
+  }
+
+  struct stat status = {};
+  if (::fstat(fd, &status) != 0)
+  {
+    ::close(fd);
+    throw_system_error(path);
+  }
+
+  if (status.st_size > 0)
+  {
+    auto* data =
+      ::mmap(nullptr, static_cast<std::size_t>(status.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) // NOLINT(*-cstyle-cast,performance-no-int-to-ptr)
+    {
+      ::close(fd);
+      throw_system_error(path);
+    }
+    data_ = data;
+    size_ = static_cast<std::size_t>(status.st_size);
+  }
+
+  // The mapping stays valid once the file is closed.
+  ::close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+  unmap();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+  : data_{std::exchange(other.data_, nullptr)}
+  , size_{std::exchange(other.size_, 0)}
+{}
+
+MappedFile&
+MappedFile::operator=(MappedFile&& other) noexcept
+{
+  if (this != &other)
+  {
+    unmap();
+    data_ = std::exchange(other.data_, nullptr);
+    size_ = std::exchange(other.size_, 0);
+  }
+  return *this;
+}
+
+// ---------------------------------------------------------------------------------------------- //
+
+std::span<const std::uint8_t>
+MappedFile::bytes() const noexcept
+{
+  return {static_cast<const std::uint8_t*>(data_), size_};
+}
+
+std::string_view
+MappedFile::str() const noexcept
+{
+  return {static_cast<const char*>(data_), size_};
+}
+
+// ---------------------------------------------------------------------------------------------- //
+
+void
+MappedFile::unmap() noexcept
+{
+  if (data_ != nullptr)
+  {
+    ::munmap(data_, size_);
+  }
+}
+
+// ---------------------------------------------------------------------------------------------- //
+
+} // namespace clox
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string_view>
+
+namespace clox {
+
+// ---------------------------------------------------------------------------------------------- //
+
+// Read-only mapping of a whole file in memory. Its pages come from the page cache and are shared by
+// all processes which map the same file, instead of being copied into each of them.
+class MappedFile
+{
+public:
+  // Throw std::system_error if the file can't be opened or mapped.
+  explicit MappedFile(const std::filesystem::path& path);
+
+  ~MappedFile();
+  MappedFile(const MappedFile&) = delete;
+  MappedFile(MappedFile&&) noexcept;
+  MappedFile& operator=(const MappedFile&) = delete;
+  MappedFile& operator=(MappedFile&&) noexcept;
+
+  [[nodiscard]] std::span<const std::uint8_t> bytes() const noexcept;
+  [[nodiscard]] std::string_view str() const noexcept;
+
+private:
+  void unmap() noexcept;
+
+private:
+  // Empty files are not mapped.
+  void* data_{nullptr};
+  std::size_t size_{0};
+};
+
+// ---------------------------------------------------------------------------------------------- //
+
+} // namespace clox
@@ -1,47 +1,252 @@
 #include "clox/memory.hh"
 
+#include <algorithm>
+#include <ostream>
+#include <stdexcept>
+#include <utility>
+
 #include <fmt/core.h>
-#include <gsl/pointers>
+
+#include "clox/code.hh"
+#include "clox/detail/hash.hh"
+#include "clox/detail/visitor.hh"
 
 namespace clox {
 
 // ---------------------------------------------------------------------------------------------- //
 
-Memory::~Memory()
+Memory::Memory(GcConfig gc_config)
+  : gc_config_{gc_config}
+  , next_collection_{gc_config.min_heap_size}
+{}
+
+// ---------------------------------------------------------------------------------------------- //
+
+const ObjString*
+Memory::make_string(std::string_view str)
 {
-  string_set_.clear_and_dispose([](gsl::owner<ObjString*> obj) { delete obj; });
+  const auto hash = detail::hash(str);
+
+  if (const auto* obj = strings_.find(str, hash))
+  {
+    return obj;
+  }
+
+  auto* obj = ObjString::make(arena_, str, hash);
+  strings_.insert(*obj);
+  return obj;
+}
+
+InternTable::Stats
+Memory::interned_strings_stats() const
+{
+  return strings_.stats();
+}
+
+Arena::Stats
+Memory::arena_stats() const noexcept
+{
+  return arena_.stats();
 }
 
 // ---------------------------------------------------------------------------------------------- //
 
-const ObjString*
-Memory::make_string(std::string str)
+namespace /* anonymous */ {
+
+// Precondition: value.is_string().
+RopeNode
+rope_node(Value value) noexcept
 {
-  // TODO: rehash if string_set_.size() >= 1024. Requires constant-time size().
+  if (value.is<const ObjString*>())
+  {
+    return value.unchecked_as<const ObjString*>();
+  }
+  const auto* rope = value.unchecked_as<const ObjRope*>();
+  // Don't keep the parts of a rope which has already been flattened.
+  return rope->flattened != nullptr ? RopeNode{rope->flattened} : RopeNode{rope};
+}
 
-  auto commit = ObjStringSet::insert_commit_data{};
-  const auto [it, inserted] = string_set_.insert_check(
-    str,
-    [](auto&& lhs) { return std::hash<std::string>{}(lhs); },
-    [](auto&& lhs, auto&& rhs) { return lhs == rhs.str; },
-    commit);
+void
+append_to(std::string& str, RopeNode node)
+{
+  std::visit(detail::visitor{[&](const ObjString* obj) { str += obj->str(); },
+                             [&](const ObjRope* rope) { rope->append_to(str); }},
+             node);
+}
+
+} // namespace
+
+Value
+Memory::concatenate(Value lhs, Value rhs)
+{
+  const auto lhs_node = rope_node(lhs);
+  const auto rhs_node = rope_node(rhs);
 
-  if (inserted)
+  if (length(lhs_node) + length(rhs_node) < min_rope_length)
   {
-    auto* obj = new ObjString{std::move(str)};
-    string_set_.insert_commit(*obj, commit);
-    return obj;
+    auto str = std::string{};
+    append_to(str, lhs_node);
+    append_to(str, rhs_node);
+    return make_string(str);
   }
-  else
+
+  return ropes_.emplace_back(arena_.make<ObjRope>(0, lhs_node, rhs_node));
+}
+
+Value
+Memory::intern(Value value)
+{
+  if (not value.is<const ObjRope*>())
+  {
+    return value;
+  }
+
+  const auto* rope = value.unchecked_as<const ObjRope*>();
+  if (rope->flattened == nullptr)
+  {
+    rope->flattened = make_string(rope->str());
+  }
+  return rope->flattened;
+}
+
+// ---------------------------------------------------------------------------------------------- //
+
+void
+Memory::add_code(std::weak_ptr<const Code> code)
+{
+  std::erase_if(codes_, [](const auto& weak_code) { return weak_code.expired(); });
+  codes_.push_back(std::move(code));
+}
+
+bool
+Memory::should_collect() const noexcept
+{
+  return heap_size() >= next_collection_;
+}
+
+void
+Memory::collect(std::initializer_list<std::span<const Value>> roots)
+{
+  const auto start = std::chrono::steady_clock::now();
+  const auto heap_size_before = heap_size();
+  const auto nb_objects_before = strings_.size() + ropes_.size();
+
+  for (const auto values : roots)
+  {
+    std::ranges::for_each(values, [this](Value value) { mark(value); });
+  }
+  std::erase_if(codes_, [](const auto& weak_code) { return weak_code.expired(); });
+  for (const auto& weak_code : codes_)
+  {
+    if (const auto code = weak_code.lock())
+    {
+      std::ranges::for_each(code->constants(), [this](Value value) { mark(value); });
+    }
+  }
+  // Ropes are marked with an explicit stack, as they can be very deep.
+  while (not gray_ropes_.empty())
   {
-    return &*it;
+    const auto* rope = gray_ropes_.back();
+    gray_ropes_.pop_back();
+    mark(rope->lhs);
+    mark(rope->rhs);
+    if (rope->flattened != nullptr)
+    {
+      rope->flattened->marked = true;
+    }
   }
+
+  sweep();
+
+  const auto heap_size_after = heap_size();
+  next_collection_ = std::max(gc_config_.min_heap_size,
+                              static_cast<std::size_t>(static_cast<double>(heap_size_after) *
+                                                       gc_config_.growth_factor));
+
+  const auto pause = std::chrono::steady_clock::now() - start;
+  gc_stats_.nb_collections += 1;
+  gc_stats_.nb_freed_objects += nb_objects_before - (strings_.size() + ropes_.size());
+  gc_stats_.nb_freed_bytes += heap_size_before - heap_size_after;
+  gc_stats_.total_pause += pause;
+  gc_stats_.max_pause = std::max<std::chrono::nanoseconds>(gc_stats_.max_pause, pause);
+}
+
+void
+Memory::mark(Value value) noexcept
+{
+  if (value.is<const ObjString*>())
+  {
+    value.unchecked_as<const ObjString*>()->marked = true;
+  }
+  else if (value.is<const ObjRope*>())
+  {
+    mark(RopeNode{value.unchecked_as<const ObjRope*>()});
+  }
+}
+
+void
+Memory::mark(RopeNode node) noexcept
+{
+  std::visit(detail::visitor{[](const ObjString* obj) { obj->marked = true; },
+                             [this](const ObjRope* rope)
+                             {
+                               if (not std::exchange(rope->marked, true))
+                               {
+                                 gray_ropes_.push_back(rope);
+                               }
+                             }},
+             node);
+}
+
+void
+Memory::sweep() noexcept
+{
+  // Marks are cleared on survivors for the next collection.
+  strings_.erase_if([](const ObjString& obj) { return not std::exchange(obj.marked, false); },
+                    [this](const ObjString* obj) { ObjString::dispose(arena_, obj); });
+  std::erase_if(ropes_,
+                [this](const ObjRope* rope)
+                {
+                  if (std::exchange(rope->marked, false))
+                  {
+                    return false;
+                  }
+                  arena_.dispose(rope);
+                  return true;
+                });
+}
+
+std::size_t
+Memory::heap_size() const noexcept
+{
+  return arena_.stats().allocated;
+}
+
+const GcStats&
+Memory::gc_stats() const noexcept
+{
+  return gc_stats_;
+}
+
+std::ostream&
+operator<<(std::ostream& os, const GcStats& stats)
+{
+  using std::chrono::duration_cast;
+  using std::chrono::microseconds;
+
+  return os << fmt::format("{} collections, {} objects ({} bytes) freed, pauses: total {}us, "
+                           "max {}us",
+                           stats.nb_collections,
+                           stats.nb_freed_objects,
+                           stats.nb_freed_bytes,
+                           duration_cast<microseconds>(stats.total_pause).count(),
+                           duration_cast<microseconds>(stats.max_pause).count());
 }
 
 // ---------------------------------------------------------------------------------------------- //
 
 detail::GlobalVariableIndex
-Memory::maybe_add_global_variable(const std::string& name)
+Memory::maybe_add_global_variable(std::string_view name)
 {
   if (const auto search = global_variables_.find(name); search != cend(global_variables_))
   {
@@ -49,30 +254,36 @@ Memory::maybe_add_global_variable(const std::string& name)
   }
   else
   {
-    const auto it = global_variables_.insert(search, {name, last_global_variable_index_});
-    ++last_global_variable_index_;
+    const auto index = detail::GlobalVariableIndex{
+      static_cast<std::uint32_t>(global_variable_names_.size())};
+    const auto it = global_variables_.emplace_hint(search, std::string{name}, index);
+    global_variable_names_.push_back(it->first);
 
-    return it->second;
+    return index;
   }
 }
 
-std::string
+std::string_view
 Memory::get_global_variable(clox::detail::GlobalVariableIndex index) const
 {
-  // TODO implement reverse lookup index -> variable name
-  const auto search = std::find_if(cbegin(global_variables_),
-                                   cend(global_variables_),
-                                   [index](auto&& entry) { return entry.second == index; });
-
-  if (search != std::cend(global_variables_))
-  {
-    return search->first;
-  }
-  else
+  const auto i = static_cast<std::uint32_t>(index);
+  if (i >= global_variable_names_.size())
   {
-    throw std::runtime_error{
-      fmt::format("Variable with index {} not found ", static_cast<std::uint16_t>(index))};
+    throw std::runtime_error{fmt::format("Variable with index {} not found ", i)};
   }
+  return global_variable_names_[i];
+}
+
+std::size_t
+Memory::nb_global_variables() const noexcept
+{
+  return global_variable_names_.size();
+}
+
+std::vector<std::string_view>
+Memory::global_variable_names() const
+{
+  return global_variable_names_;
 }
 
 // ---------------------------------------------------------------------------------------------- //
@@ -1,43 +1,127 @@
 #pragma once
 
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <iosfwd>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
+#include "clox/arena.hh"
+#include "clox/detail/hash.hh"
 #include "clox/detail/index.hh"
+#include "clox/intern_table.hh"
+#include "clox/obj_rope.hh"
 #include "clox/obj_string.hh"
+#include "clox/value.hh"
 
 namespace clox {
 
+class Code;
+
 // ---------------------------------------------------------------------------------------------- //
 
-class Memory
+// When garbage is collected.
+struct GcConfig
+{
+  // Heap size, in bytes, below which no collection is triggered.
+  std::size_t min_heap_size{1024 * 1024};
+  // After a collection, the next one is triggered when the heap has grown by this factor.
+  double growth_factor{2.0};
+};
+
+struct GcStats
 {
-  static constexpr auto string_set_nb_buckets = 1024;
+  std::size_t nb_collections{0};
+  std::size_t nb_freed_objects{0};
+  std::size_t nb_freed_bytes{0};
+  std::chrono::nanoseconds total_pause{0};
+  std::chrono::nanoseconds max_pause{0};
+};
 
+std::ostream&
+operator<<(std::ostream&, const GcStats&);
+
+// ---------------------------------------------------------------------------------------------- //
+
+class Memory
+{
 public:
-  Memory()
-    : string_set_buckets_{string_set_nb_buckets}
-    , string_set_{ObjStringSet::bucket_traits{string_set_buckets_.data(), string_set_nb_buckets}}
-  {}
+  explicit Memory(GcConfig gc_config = {});
 
-  ~Memory();
-  //  TODO: check if move constructor is valid with an intrusive container
+  ~Memory() = default;
   Memory(const Memory&) = delete;
   Memory(Memory&&) noexcept = default;
   Memory& operator=(const Memory&) = delete;
   Memory& operator=(Memory&&) = default;
 
-  [[nodiscard]] const ObjString* make_string(std::string);
+  [[nodiscard]] const ObjString* make_string(std::string_view);
+  [[nodiscard]] InternTable::Stats interned_strings_stats() const;
+  [[nodiscard]] Arena::Stats arena_stats() const noexcept;
 
-  [[nodiscard]] detail::GlobalVariableIndex maybe_add_global_variable(const std::string&);
-  [[nodiscard]] std::string get_global_variable(detail::GlobalVariableIndex) const;
+  // Concatenate two strings, which may be ropes. Short results are interned right away, longer
+  // ones are ropes which are flattened only when needed.
+  [[nodiscard]] Value concatenate(Value lhs, Value rhs);
+
+  // Get the interned string with the same characters as `value` if it's a rope, `value` otherwise.
+  // The result is cached in the rope.
+  [[nodiscard]] Value intern(Value value);
+
+  // Concatenations shorter than this are flattened.
+  static constexpr std::size_t min_rope_length = 64;
+
+  // Constants of `code` are roots of garbage collections as long as `code` is alive.
+  void add_code(std::weak_ptr<const Code> code);
+
+  // Whether the heap has grown enough since the last collection to trigger a new one.
+  [[nodiscard]] bool should_collect() const noexcept;
+
+  // Free strings and ropes which are not reachable from `roots` or from the constants of live code.
+  // The intern table doesn't keep strings alive.
+  // A VM collects with its own stack and globals as roots: a Memory must thus be used by a single
+  // VM at a time, and values of another VM which shares it may be freed.
+  void collect(std::initializer_list<std::span<const Value>> roots);
+
+  // Bytes used by strings and ropes.
+  [[nodiscard]] std::size_t heap_size() const noexcept;
+  [[nodiscard]] const GcStats& gc_stats() const noexcept;
+
+  [[nodiscard]] detail::GlobalVariableIndex maybe_add_global_variable(std::string_view);
+  [[nodiscard]] std::string_view get_global_variable(detail::GlobalVariableIndex) const;
+  [[nodiscard]] std::size_t nb_global_variables() const noexcept;
+  // Names of the global variables, ordered by index.
+  [[nodiscard]] std::vector<std::string_view> global_variable_names() const;
 
 private:
-  std::vector<ObjStringSet::bucket_type> string_set_buckets_;
-  ObjStringSet string_set_;
+  void mark(Value) noexcept;
+  void mark(RopeNode) noexcept;
+  void sweep() noexcept;
+
+private:
+  // Storage of all strings and ropes. What the collector doesn't free is released at once with
+  // Memory.
+  Arena arena_{};
+  InternTable strings_{};
+  std::vector<const ObjRope*> ropes_{};
+
+  GcConfig gc_config_;
+  GcStats gc_stats_{};
+  std::size_t next_collection_;
+  std::vector<std::weak_ptr<const Code>> codes_{};
+  // Ropes which have been marked but whose parts have not been marked yet.
+  std::vector<const ObjRope*> gray_ropes_{};
 
-  std::unordered_map<std::string, detail::GlobalVariableIndex> global_variables_{};
-  detail::GlobalVariableIndex last_global_variable_index_{0};
+  // Looked up by views of identifiers: a name is only copied when a variable is added.
+  std::unordered_map<std::string, detail::GlobalVariableIndex, detail::StringHash, std::equal_to<>>
+    global_variables_{};
+  // Names of the global variables by index, viewing the keys of `global_variables_`, which are not
+  // moved by rehashes.
+  std::vector<std::string_view> global_variable_names_{};
 };
 
 // ---------------------------------------------------------------------------------------------- //
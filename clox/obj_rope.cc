@@ -0,0 +1,92 @@
+#include <ostream>
+#include <vector>
+
+#include "clox/detail/visitor.hh"
+#include "clox/obj_rope.hh"
+
+namespace clox {
+
+// ---------------------------------------------------------------------------------------------- //
+
+namespace /* anonymous */ {
+
+// Call `f` on each flat part of the rope, from left to right. Ropes built by repeated
+// concatenations are very unbalanced, so they are walked without recursion.
+template<typename F>
+void
+for_each_part(const ObjRope& rope, F&& f)
+{
+  auto nodes = std::vector<RopeNode>{rope.rhs, rope.lhs};
+  while (not nodes.empty())
+  {
+    const auto node = nodes.back();
+    nodes.pop_back();
+
+    std::visit(detail::visitor{[&](const ObjString* str) { f(str->str()); },
+                               [&](const ObjRope* sub_rope)
+                               {
+                                 if (sub_rope->flattened != nullptr)
+                                 {
+                                   f(sub_rope->flattened->str());
+                                 }
+                                 else
+                                 {
+                                   nodes.push_back(sub_rope->rhs);
+                                   nodes.push_back(sub_rope->lhs);
+                                 }
+                               }},
+               node);
+  }
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------------------------- //
+
+std::size_t
+length(RopeNode node) noexcept
+{
+  return std::visit(detail::visitor{[](const ObjString* str) { return str->length; },
+                                    [](const ObjRope* rope) { return rope->length; }},
+                    node);
+}
+
+// ---------------------------------------------------------------------------------------------- //
+
+ObjRope::ObjRope(RopeNode lhs, RopeNode rhs)
+  : lhs{lhs}
+  , rhs{rhs}
+  , length{clox::length(lhs) + clox::length(rhs)}
+{}
+
+// ---------------------------------------------------------------------------------------------- //
+
+void
+ObjRope::append_to(std::string& str) const
+{
+  str.reserve(str.size() + length);
+  for_each_part(*this, [&](std::string_view part) { str += part; });
+}
+
+std::string
+ObjRope::str() const
+{
+  auto str = std::string{};
+  append_to(str);
+  return str;
+}
+
+std::ostream&
+operator<<(std::ostream& os, const ObjRope& rope)
+{
+  if (rope.flattened != nullptr)
+  {
+    return os << *rope.flattened;
+  }
+  for_each_part(rope, [&](std::string_view part) { os << part; });
+  return os;
+}
+
+// ---------------------------------------------------------------------------------------------- //
+
+} // namespace clox
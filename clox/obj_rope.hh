@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+#include <variant>
+
+#include "clox/obj_string.hh"
+
+namespace clox {
+
+// ---------------------------------------------------------------------------------------------- //
+
+struct ObjRope;
+
+// One of the two parts of a rope.
+using RopeNode = std::variant<const ObjString*, const ObjRope*>;
+
+// ---------------------------------------------------------------------------------------------- //
+
+// Concatenation of two strings, which is flattened only when its characters are needed as a whole.
+// Building a string by repeated concatenations thus doesn't copy and hash the string built so far
+// at each step.
+struct ObjRope
+{
+  ObjRope(RopeNode lhs, RopeNode rhs);
+
+  ObjRope(const ObjRope&) = delete;
+  ~ObjRope() = default;
+  ObjRope(ObjRope&&) = delete;
+  ObjRope& operator=(const ObjRope&) = delete;
+  ObjRope& operator=(ObjRope&&) noexcept = delete;
+
+  RopeNode lhs;
+  RopeNode rhs;
+  std::size_t length;
+  // Interned string with the same characters, set by Memory::intern().
+  mutable const ObjString* flattened{nullptr};
+  // Set while Memory collects garbage if the rope is reachable.
+  mutable bool marked{false};
+
+  // Append the characters of the rope to `str`.
+  void append_to(std::string& str) const;
+
+  [[nodiscard]] std::string str() const;
+
+  friend std::ostream& operator<<(std::ostream& os, const ObjRope& rope);
+};
+
+[[nodiscard]] std::size_t
+length(RopeNode) noexcept;
+
+// ---------------------------------------------------------------------------------------------- //
+
+} // namespace clox
@@ -1,35 +1,57 @@
+#include <algorithm>
+
+#include "clox/arena.hh"
 #include "clox/obj_string.hh"
 
 namespace clox {
 
 // ---------------------------------------------------------------------------------------------- //
 
-ObjString::ObjString(std::string str)
-  : str{std::move(str)}
+ObjString::ObjString(std::size_t length, std::uint64_t hash) noexcept
+  : hash{hash}
+  , length{length}
 {}
 
+ObjString*
+ObjString::make(Arena& arena, std::string_view str, std::uint64_t hash)
+{
+  auto* obj = arena.make<ObjString>(str.size(), str.size(), hash);
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+  std::copy(str.cbegin(), str.cend(), reinterpret_cast<char*>(obj + 1));
+  return obj;
+}
+
+void
+ObjString::dispose(Arena& arena, const ObjString* obj) noexcept
+{
+  arena.dispose(obj, obj->length);
+}
+
+std::string_view
+ObjString::str() const noexcept
+{
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+  return {reinterpret_cast<const char*>(this + 1), length};
+}
+
 // ---------------------------------------------------------------------------------------------- //
 
 std::strong_ordering
 operator<=>(const ObjString& lhs, const ObjString& rhs) noexcept
 {
-  // The following _should_ work, but it doesn't compile 🤔.
-  // return lhs.str <=> rhs.str;
-  return lhs.str == rhs.str  ? std::strong_ordering::equal
-         : lhs.str < rhs.str ? std::strong_ordering::less
-                             : std::strong_ordering::greater;
+  return lhs.str() <=> rhs.str();
 }
 
 bool
 operator==(const ObjString& lhs, const ObjString& rhs) noexcept
 {
-  return lhs.str == rhs.str;
+  return lhs.hash == rhs.hash and lhs.str() == rhs.str();
 }
 
 std::ostream&
 operator<<(std::ostream& os, const ObjString& string)
 {
-  return os << string.str;
+  return os << string.str();
 }
 
 // ---------------------------------------------------------------------------------------------- //
@@ -41,7 +63,7 @@ operator<<(std::ostream& os, const ObjString& string)
 std::size_t
 std::hash<clox::ObjString>::operator()(const clox::ObjString& obj) const noexcept
 {
-  return std::hash<std::string>{}(obj.str);
+  return obj.hash;
 }
 
 // ---------------------------------------------------------------------------------------------- //
@@ -1,23 +1,21 @@
 #pragma once
 
 #include <compare>
+#include <cstddef>
+#include <cstdint>
 #include <iosfwd>
-#include <string>
+#include <string_view>
 #include <typeindex>
 
-// Avoid an error with clang 15 where std::unary_function has been removed.
-// A fix in boost has been commited, but it's not yet available in a release.
-// https://stackoverflow.com/a/73364020/21584
-#define BOOST_NO_CXX98_FUNCTION_BASE
-#include <boost/intrusive/unordered_set.hpp>
-
 namespace clox {
 
-// ---------------------------------------------------------------------------------------------- //
+class Arena;
+class InternTable;
 
-namespace bi = boost::intrusive;
+// ---------------------------------------------------------------------------------------------- //
 
-struct ObjString : public bi::unordered_set_base_hook<bi::link_mode<bi::normal_link>>
+// Immutable string, whose characters are stored right after the object in the same allocation.
+struct ObjString
 {
   ObjString(const ObjString&) = delete;
   ~ObjString() = default;
@@ -25,22 +23,34 @@ struct ObjString : public bi::unordered_set_base_hook<bi::link_mode<bi::normal_l
   ObjString& operator=(const ObjString&) = delete;
   ObjString& operator=(ObjString&&) noexcept = delete;
 
-  std::string str;
+  // Hash of the characters, computed once when the string is created.
+  std::uint64_t hash;
+  std::size_t length;
+  // Set while Memory collects garbage if the string is reachable.
+  mutable bool marked{false};
+
+  // Allocate a string with a copy of `str` in `arena`.
+  [[nodiscard]] static ObjString* make(Arena& arena, std::string_view str, std::uint64_t hash);
+
+  // Give back to `arena` the storage of a string allocated by make().
+  static void dispose(Arena& arena, const ObjString* obj) noexcept;
 
-  explicit ObjString(std::string);
+  [[nodiscard]] std::string_view str() const noexcept;
 
   friend bool operator==(const ObjString&, const ObjString&) noexcept;
   friend std::strong_ordering operator<=>(const ObjString&, const ObjString&) noexcept;
 
   friend std::ostream& operator<<(std::ostream& os, const ObjString& string);
-};
 
-// ---------------------------------------------------------------------------------------------- //
+private:
+  friend class Arena;
+  friend class InternTable;
 
-using ObjStringSet = bi::unordered_set<ObjString,
-                                       bi::constant_time_size<false>,
-                                       bi::power_2_buckets<true>,
-                                       bi::hash<std::hash<ObjString>>>;
+  ObjString(std::size_t length, std::uint64_t hash) noexcept;
+
+  // Next string in the same bucket of the InternTable.
+  ObjString* next_in_bucket_{nullptr};
+};
 
 // ---------------------------------------------------------------------------------------------- //
 
@@ -4,7 +4,11 @@
 
 #include <iostream>
 
+#include <array>
+#include <cstdint>
 #include <iosfwd>
+#include <string_view>
+#include <type_traits>
 #include <variant>
 
 #include <fmt/core.h>
@@ -16,90 +20,141 @@ namespace clox {
 
 // ---------------------------------------------------------------------------------------------- //
 
+// Each opcode declares how many values it pops from the stack (`pops`), then how many values it
+// pushes (`pushes`). They are used to verify the bytecode.
+
+// Instructions whose operand is an index come in two forms: a short one, whose operand is a
+// detail::ShortIndex, and a long one, suffixed by _LONG, whose operand is a full index.
+template<typename Operand>
+inline constexpr std::string_view long_suffix = "";
+template<>
+inline constexpr std::string_view long_suffix<detail::ConstantIndex> = "_LONG";
+template<>
+inline constexpr std::string_view long_suffix<detail::GlobalVariableIndex> = "_LONG";
+
+// Arithmetic operators work on numbers, whereas comparison operators work on any values.
 template<typename Impl>
 struct OpBinary
 {
-  [[nodiscard]] std::string disassemble(const auto&) const { return std::string{Impl::sv}; }
+  static constexpr std::size_t pops = 2;
+  static constexpr std::size_t pushes = 1;
 
-  Value operator()(Value lhs, Value rhs) const
-    noexcept(noexcept(std::declval<Impl>()(Value{}, Value{})))
-  {
-    return Impl{}(lhs, rhs);
-  }
+  [[nodiscard]] std::string disassemble(const auto&) const { return std::string{Impl::sv}; }
 };
 
 // Arithmetic
 struct OpAddImpl
 {
   static constexpr std::string_view sv = "OP_ADD";
-  Value operator()(Value lhs, Value rhs) const { return lhs.as<double>() + rhs.as<double>(); }
+  double operator()(double lhs, double rhs) const noexcept { return lhs + rhs; }
 };
 using OpAdd = OpBinary<OpAddImpl>;
 
 struct OpDivideImpl
 {
   static constexpr std::string_view sv = "OP_DIVIDE";
-  Value operator()(Value lhs, Value rhs) const { return lhs.as<double>() / rhs.as<double>(); }
+  double operator()(double lhs, double rhs) const noexcept { return lhs / rhs; }
 };
 using OpDivide = OpBinary<OpDivideImpl>;
 
 struct OpMultiplyImpl
 {
   static constexpr std::string_view sv = "OP_MULTIPLY";
-  Value operator()(Value lhs, Value rhs) const { return lhs.as<double>() * rhs.as<double>(); }
+  double operator()(double lhs, double rhs) const noexcept { return lhs * rhs; }
 };
 using OpMultiply = OpBinary<OpMultiplyImpl>;
 
 struct OpSubtractImpl
 {
   static constexpr std::string_view sv = "OP_SUBTRACT";
-  Value operator()(Value lhs, Value rhs) const { return lhs.as<double>() - rhs.as<double>(); }
+  double operator()(double lhs, double rhs) const noexcept { return lhs - rhs; }
 };
 using OpSubtract = OpBinary<OpSubtractImpl>;
 
 struct OpGreaterImpl
 {
   static constexpr std::string_view sv = "OP_GREATER";
-  Value operator()(Value lhs, Value rhs) const { return lhs > rhs; }
+  bool operator()(Value lhs, Value rhs) const { return lhs > rhs; }
 };
 using OpGreater = OpBinary<OpGreaterImpl>;
 
 struct OpLessImpl
 {
   static constexpr std::string_view sv = "OP_LESS";
-  Value operator()(Value lhs, Value rhs) const { return lhs < rhs; }
+  bool operator()(Value lhs, Value rhs) const { return lhs < rhs; }
 };
 using OpLess = OpBinary<OpLessImpl>;
 
+// Fused comparison followed by OP_NOT
+struct OpNotEqualImpl
+{
+  static constexpr std::string_view sv = "OP_NOT_EQUAL";
+  bool operator()(Value lhs, Value rhs) const { return lhs != rhs; }
+};
+using OpNotEqual = OpBinary<OpNotEqualImpl>;
+
+struct OpNotGreaterImpl
+{
+  static constexpr std::string_view sv = "OP_NOT_GREATER";
+  bool operator()(Value lhs, Value rhs) const { return not(lhs > rhs); }
+};
+using OpNotGreater = OpBinary<OpNotGreaterImpl>;
+
+struct OpNotLessImpl
+{
+  static constexpr std::string_view sv = "OP_NOT_LESS";
+  bool operator()(Value lhs, Value rhs) const { return not(lhs < rhs); }
+};
+using OpNotLess = OpBinary<OpNotLessImpl>;
+
 // ---------------------------------------------------------------------------------------------- //
 
-struct OpConstant
+template<typename Operand>
+struct BasicOpConstant
 {
-  detail::ConstantIndex constant;
+  static constexpr std::size_t pops = 0;
+  static constexpr std::size_t pushes = 1;
+
+  Operand constant;
 
   [[nodiscard]] std::string disassemble(const auto& chunk) const
   {
-    return fmt::format("OP_CONSTANT {}", chunk.code->get_constant(constant));
+    return fmt::format(
+      "OP_CONSTANT{} {}", long_suffix<Operand>, chunk.code->get_constant(constant));
   }
 };
 
+using OpConstant = BasicOpConstant<detail::ShortConstantIndex>;
+using OpConstantLong = BasicOpConstant<detail::ConstantIndex>;
+
 // ---------------------------------------------------------------------------------------------- //
 
-struct OpDefineGlobalVar
+template<typename Operand>
+struct BasicOpDefineGlobalVar
 {
-  detail::GlobalVariableIndex global_variable_index;
+  static constexpr std::size_t pops = 1;
+  static constexpr std::size_t pushes = 0;
+
+  Operand global_variable_index;
 
   [[nodiscard]] std::string disassemble(const auto& chunk) const
   {
-    return fmt::format("OP_DEFINE_GLOBAL_VAR {}",
+    return fmt::format("OP_DEFINE_GLOBAL_VAR{} {}",
+                       long_suffix<Operand>,
                        chunk.memory->get_global_variable(global_variable_index));
   }
 };
 
+using OpDefineGlobalVar = BasicOpDefineGlobalVar<detail::ShortGlobalVariableIndex>;
+using OpDefineGlobalVarLong = BasicOpDefineGlobalVar<detail::GlobalVariableIndex>;
+
 // ---------------------------------------------------------------------------------------------- //
 
 struct OpEqual
 {
+  static constexpr std::size_t pops = 2;
+  static constexpr std::size_t pushes = 1;
+
   [[nodiscard]] std::string disassemble(const auto&) const { return "OP_EQUAL"; }
 };
 
@@ -107,26 +162,40 @@ struct OpEqual
 
 struct OpFalse
 {
+  static constexpr std::size_t pops = 0;
+  static constexpr std::size_t pushes = 1;
+
   [[nodiscard]] std::string disassemble(const auto&) const { return "OP_FALSE"; }
 };
 
 // ---------------------------------------------------------------------------------------------- //
 
-struct OpGetGlobalVar
+template<typename Operand>
+struct BasicOpGetGlobalVar
 {
-  detail::GlobalVariableIndex global_variable_index;
+  static constexpr std::size_t pops = 0;
+  static constexpr std::size_t pushes = 1;
+
+  Operand global_variable_index;
 
   [[nodiscard]] std::string disassemble(const auto& chunk) const
   {
-    return fmt::format("OP_GET_GLOBAL_VAR {}",
+    return fmt::format("OP_GET_GLOBAL_VAR{} {}",
+                       long_suffix<Operand>,
                        chunk.memory->get_global_variable(global_variable_index));
   }
 };
 
+using OpGetGlobalVar = BasicOpGetGlobalVar<detail::ShortGlobalVariableIndex>;
+using OpGetGlobalVarLong = BasicOpGetGlobalVar<detail::GlobalVariableIndex>;
+
 // ---------------------------------------------------------------------------------------------- //
 
 struct OpNegate
 {
+  static constexpr std::size_t pops = 1;
+  static constexpr std::size_t pushes = 1;
+
   [[nodiscard]] std::string disassemble(const auto&) const { return "OP_NEGATE"; }
 };
 
@@ -134,6 +203,9 @@ struct OpNegate
 
 struct OpNil
 {
+  static constexpr std::size_t pops = 0;
+  static constexpr std::size_t pushes = 1;
+
   [[nodiscard]] std::string disassemble(const auto&) const { return "OP_NIL"; }
 };
 
@@ -141,6 +213,9 @@ struct OpNil
 
 struct OpNot
 {
+  static constexpr std::size_t pops = 1;
+  static constexpr std::size_t pushes = 1;
+
   [[nodiscard]] std::string disassemble(const auto&) const { return "OP_NOT"; }
 };
 
@@ -149,6 +224,9 @@ struct OpNot
 template<std::size_t N>
 struct OpPop
 {
+  static constexpr std::size_t pops = N;
+  static constexpr std::size_t pushes = 0;
+
   [[nodiscard]] std::string disassemble(const auto&) const { return fmt::format("OP_POP<{}>", N); }
 };
 
@@ -156,6 +234,9 @@ struct OpPop
 
 struct OpPrint
 {
+  static constexpr std::size_t pops = 1;
+  static constexpr std::size_t pushes = 0;
+
   [[nodiscard]] std::string disassemble(const auto&) const { return "OP_PRINT"; }
 };
 
@@ -163,27 +244,162 @@ struct OpPrint
 
 struct OpReturn
 {
+  static constexpr std::size_t pops = 0;
+  static constexpr std::size_t pushes = 0;
+
   [[nodiscard]] std::string disassemble(const auto&) const { return "OP_RETURN"; }
 };
 
 // ---------------------------------------------------------------------------------------------- //
 
-struct OpSetGlobal
+template<typename Operand>
+struct BasicOpSetGlobal
 {
-  detail::GlobalVariableIndex global_variable_index;
+  static constexpr std::size_t pops = 1;
+  static constexpr std::size_t pushes = 1;
+
+  Operand global_variable_index;
 
-  [[nodiscard]] std::string disassemble(const auto&) const { return "OP_SET_GLOBAL"; }
+  [[nodiscard]] std::string disassemble(const auto&) const
+  {
+    return fmt::format("OP_SET_GLOBAL{}", long_suffix<Operand>);
+  }
 };
 
+using OpSetGlobal = BasicOpSetGlobal<detail::ShortGlobalVariableIndex>;
+using OpSetGlobalLong = BasicOpSetGlobal<detail::GlobalVariableIndex>;
+
 // ---------------------------------------------------------------------------------------------- //
 
 struct OpTrue
 {
+  static constexpr std::size_t pops = 0;
+  static constexpr std::size_t pushes = 1;
+
   [[nodiscard]] std::string disassemble(const auto&) const { return "OP_TRUE"; }
 };
 
 // ---------------------------------------------------------------------------------------------- //
 
+// Accesses to global variables which the compiler proved to be defined, and which therefore don't
+// need to be checked.
+
+template<typename Operand>
+struct BasicOpGetGlobalVarUnchecked
+{
+  static constexpr std::size_t pops = 0;
+  static constexpr std::size_t pushes = 1;
+
+  // Checked by verify().
+  static constexpr bool assumes_defined = true;
+
+  Operand global_variable_index;
+
+  [[nodiscard]] std::string disassemble(const auto& chunk) const
+  {
+    return fmt::format("OP_GET_GLOBAL_VAR_UNCHECKED{} {}",
+                       long_suffix<Operand>,
+                       chunk.memory->get_global_variable(global_variable_index));
+  }
+};
+
+using OpGetGlobalVarUnchecked = BasicOpGetGlobalVarUnchecked<detail::ShortGlobalVariableIndex>;
+using OpGetGlobalVarUncheckedLong = BasicOpGetGlobalVarUnchecked<detail::GlobalVariableIndex>;
+
+template<typename Operand>
+struct BasicOpSetGlobalUnchecked
+{
+  static constexpr std::size_t pops = 1;
+  static constexpr std::size_t pushes = 1;
+
+  // Checked by verify().
+  static constexpr bool assumes_defined = true;
+
+  Operand global_variable_index;
+
+  [[nodiscard]] std::string disassemble(const auto& chunk) const
+  {
+    return fmt::format("OP_SET_GLOBAL_UNCHECKED{} {}",
+                       long_suffix<Operand>,
+                       chunk.memory->get_global_variable(global_variable_index));
+  }
+};
+
+using OpSetGlobalUnchecked = BasicOpSetGlobalUnchecked<detail::ShortGlobalVariableIndex>;
+using OpSetGlobalUncheckedLong = BasicOpSetGlobalUnchecked<detail::GlobalVariableIndex>;
+
+// ---------------------------------------------------------------------------------------------- //
+
+// Arithmetic operator whose right operand is a constant.
+template<typename Impl>
+struct OpBinaryConstant
+{
+  static constexpr std::size_t pops = 1;
+  static constexpr std::size_t pushes = 1;
+
+  detail::ShortConstantIndex constant;
+
+  [[nodiscard]] std::string disassemble(const auto& chunk) const
+  {
+    return fmt::format("{}_CONSTANT {}", Impl::sv, chunk.code->get_constant(constant));
+  }
+};
+
+using OpAddConstant = OpBinaryConstant<OpAddImpl>;
+using OpDivideConstant = OpBinaryConstant<OpDivideImpl>;
+using OpMultiplyConstant = OpBinaryConstant<OpMultiplyImpl>;
+using OpSubtractConstant = OpBinaryConstant<OpSubtractImpl>;
+
+// ---------------------------------------------------------------------------------------------- //
+
+// Arithmetic operator whose right operand is a global variable.
+template<typename Impl>
+struct OpBinaryGlobal
+{
+  static constexpr std::size_t pops = 1;
+  static constexpr std::size_t pushes = 1;
+
+  detail::ShortGlobalVariableIndex global_variable_index;
+
+  [[nodiscard]] std::string disassemble(const auto& chunk) const
+  {
+    return fmt::format(
+      "{}_GLOBAL_VAR {}", Impl::sv, chunk.memory->get_global_variable(global_variable_index));
+  }
+};
+
+using OpAddGlobal = OpBinaryGlobal<OpAddImpl>;
+using OpDivideGlobal = OpBinaryGlobal<OpDivideImpl>;
+using OpMultiplyGlobal = OpBinaryGlobal<OpMultiplyImpl>;
+using OpSubtractGlobal = OpBinaryGlobal<OpSubtractImpl>;
+
+// Arithmetic operator whose right operand is a global variable proved to be defined.
+template<typename Impl>
+struct OpBinaryGlobalUnchecked
+{
+  static constexpr std::size_t pops = 1;
+  static constexpr std::size_t pushes = 1;
+
+  // Checked by verify().
+  static constexpr bool assumes_defined = true;
+
+  detail::ShortGlobalVariableIndex global_variable_index;
+
+  [[nodiscard]] std::string disassemble(const auto& chunk) const
+  {
+    return fmt::format("{}_GLOBAL_VAR_UNCHECKED {}",
+                       Impl::sv,
+                       chunk.memory->get_global_variable(global_variable_index));
+  }
+};
+
+using OpAddGlobalUnchecked = OpBinaryGlobalUnchecked<OpAddImpl>;
+using OpDivideGlobalUnchecked = OpBinaryGlobalUnchecked<OpDivideImpl>;
+using OpMultiplyGlobalUnchecked = OpBinaryGlobalUnchecked<OpMultiplyImpl>;
+using OpSubtractGlobalUnchecked = OpBinaryGlobalUnchecked<OpSubtractImpl>;
+
+// ---------------------------------------------------------------------------------------------- //
+
 using Opcode = std::variant<OpAdd,
                             OpConstant,
                             OpDefineGlobalVar,
@@ -203,7 +419,156 @@ using Opcode = std::variant<OpAdd,
                             OpSetGlobal,
                             OpSubtract,
                             OpReturn,
-                            OpTrue>;
+                            OpTrue,
+                            OpNotEqual,
+                            OpNotGreater,
+                            OpNotLess,
+                            OpAddConstant,
+                            OpDivideConstant,
+                            OpMultiplyConstant,
+                            OpSubtractConstant,
+                            OpAddGlobal,
+                            OpDivideGlobal,
+                            OpMultiplyGlobal,
+                            OpSubtractGlobal,
+                            OpGetGlobalVarUnchecked,
+                            OpSetGlobalUnchecked,
+                            OpAddGlobalUnchecked,
+                            OpDivideGlobalUnchecked,
+                            OpMultiplyGlobalUnchecked,
+                            OpSubtractGlobalUnchecked,
+                            OpConstantLong,
+                            OpDefineGlobalVarLong,
+                            OpGetGlobalVarLong,
+                            OpSetGlobalLong,
+                            OpGetGlobalVarUncheckedLong,
+                            OpSetGlobalUncheckedLong>;
+
+// List of all opcodes, in the same order as in Opcode, as (mnemonic, type) pairs. It's used to
+// generate the code of the dispatch loops, which need to spell out each instruction (case labels,
+// labels for computed gotos, etc.).
+#define CLOX_OPCODES(X)                                                                            \
+  X(ADD, OpAdd)                                                                                    \
+  X(CONSTANT, OpConstant)                                                                          \
+  X(DEFINE_GLOBAL_VAR, OpDefineGlobalVar)                                                          \
+  X(DIVIDE, OpDivide)                                                                              \
+  X(EQUAL, OpEqual)                                                                                \
+  X(FALSE, OpFalse)                                                                                \
+  X(GET_GLOBAL_VAR, OpGetGlobalVar)                                                                \
+  X(GREATER, OpGreater)                                                                            \
+  X(LESS, OpLess)                                                                                  \
+  X(MULTIPLY, OpMultiply)                                                                          \
+  X(NEGATE, OpNegate)                                                                              \
+  X(NIL, OpNil)                                                                                    \
+  X(NOT, OpNot)                                                                                    \
+  X(POP_1, OpPop<1>)                                                                               \
+  X(POP_2, OpPop<2>)                                                                               \
+  X(PRINT, OpPrint)                                                                                \
+  X(SET_GLOBAL, OpSetGlobal)                                                                       \
+  X(SUBTRACT, OpSubtract)                                                                          \
+  X(RETURN, OpReturn)                                                                              \
+  X(TRUE, OpTrue)                                                                                  \
+  X(NOT_EQUAL, OpNotEqual)                                                                         \
+  X(NOT_GREATER, OpNotGreater)                                                                     \
+  X(NOT_LESS, OpNotLess)                                                                           \
+  X(ADD_CONSTANT, OpAddConstant)                                                                   \
+  X(DIVIDE_CONSTANT, OpDivideConstant)                                                             \
+  X(MULTIPLY_CONSTANT, OpMultiplyConstant)                                                         \
+  X(SUBTRACT_CONSTANT, OpSubtractConstant)                                                         \
+  X(ADD_GLOBAL_VAR, OpAddGlobal)                                                                   \
+  X(DIVIDE_GLOBAL_VAR, OpDivideGlobal)                                                             \
+  X(MULTIPLY_GLOBAL_VAR, OpMultiplyGlobal)                                                         \
+  X(SUBTRACT_GLOBAL_VAR, OpSubtractGlobal)                                                         \
+  X(GET_GLOBAL_VAR_UNCHECKED, OpGetGlobalVarUnchecked)                                             \
+  X(SET_GLOBAL_UNCHECKED, OpSetGlobalUnchecked)                                                    \
+  X(ADD_GLOBAL_VAR_UNCHECKED, OpAddGlobalUnchecked)                                                \
+  X(DIVIDE_GLOBAL_VAR_UNCHECKED, OpDivideGlobalUnchecked)                                          \
+  X(MULTIPLY_GLOBAL_VAR_UNCHECKED, OpMultiplyGlobalUnchecked)                                      \
+  X(SUBTRACT_GLOBAL_VAR_UNCHECKED, OpSubtractGlobalUnchecked)                                      \
+  X(CONSTANT_LONG, OpConstantLong)                                                                 \
+  X(DEFINE_GLOBAL_VAR_LONG, OpDefineGlobalVarLong)                                                 \
+  X(GET_GLOBAL_VAR_LONG, OpGetGlobalVarLong)                                                       \
+  X(SET_GLOBAL_LONG, OpSetGlobalLong)                                                              \
+  X(GET_GLOBAL_VAR_UNCHECKED_LONG, OpGetGlobalVarUncheckedLong)                                    \
+  X(SET_GLOBAL_UNCHECKED_LONG, OpSetGlobalUncheckedLong)
+
+// ---------------------------------------------------------------------------------------------- //
+
+namespace detail {
+
+template<typename T, typename Variant>
+struct variant_index;
+
+template<typename T, typename... Ts>
+struct variant_index<T, std::variant<Ts...>>
+{
+  static constexpr std::size_t value = []
+  {
+    constexpr bool matches[] = {std::is_same_v<T, Ts>...};
+    std::size_t i = 0;
+    while (not matches[i])
+    {
+      ++i;
+    }
+    return i;
+  }();
+};
+
+} // namespace detail
+
+// In the bytecode, an instruction is encoded with a one-byte opcode, which is the index of its type
+// in the Opcode variant, followed by the raw bytes of its operands, if any.
+
+template<typename Op>
+inline constexpr auto opcode_v =
+  static_cast<std::uint8_t>(detail::variant_index<Op, Opcode>::value);
+
+template<typename Op>
+inline constexpr std::size_t operands_size_v = std::is_empty_v<Op> ? 0 : sizeof(Op);
+
+template<typename Op>
+inline constexpr std::size_t instruction_size_v = 1 + operands_size_v<Op>;
+
+static_assert(std::variant_size_v<Opcode> <= 256, "Opcodes must fit in one byte");
+
+namespace detail {
+
+// NOLINTBEGIN(cppcoreguidelines-macro-usage)
+#define CLOX_OPCODE_INDEX(name, type) opcode_v<type>,
+inline constexpr auto listed_opcodes =
+  std::to_array<std::uint8_t>({CLOX_OPCODES(CLOX_OPCODE_INDEX)});
+#undef CLOX_OPCODE_INDEX
+// NOLINTEND(cppcoreguidelines-macro-usage)
+
+consteval bool
+opcodes_list_matches_variant()
+{
+  if (listed_opcodes.size() != std::variant_size_v<Opcode>)
+  {
+    return false;
+  }
+  for (auto i = std::size_t{0}; i < listed_opcodes.size(); ++i)
+  {
+    if (listed_opcodes[i] != i)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+static_assert(opcodes_list_matches_variant(),
+              "CLOX_OPCODES must list the Opcode alternatives in the same order");
+
+} // namespace detail
+
+// Mnemonics of opcodes, indexed by opcode.
+// NOLINTBEGIN(cppcoreguidelines-macro-usage)
+#define CLOX_OPCODE_NAME(name, type) "OP_" #name,
+inline constexpr auto opcode_names =
+  std::to_array<std::string_view>({CLOX_OPCODES(CLOX_OPCODE_NAME)});
+#undef CLOX_OPCODE_NAME
+// NOLINTEND(cppcoreguidelines-macro-usage)
 
 // ---------------------------------------------------------------------------------------------- //
 
@@ -0,0 +1,138 @@
+#include <cerrno>
+#include <iterator>
+#include <ostream>
+#include <system_error>
+
+#include <fmt/format.h>
+#include <unistd.h>
+
+#include "clox/detail/visitor.hh"
+#include "clox/obj_rope.hh"
+#include "clox/obj_string.hh"
+#include "clox/output.hh"
+
+namespace clox {
+
+// ---------------------------------------------------------------------------------------------- //
+
+Output::Output(int fd, opt_flush flush, std::size_t capacity)
+  : destination_{fd}
+  , flush_{flush}
+  , capacity_{capacity}
+{
+  buffer_.reserve(capacity_);
+}
+
+Output::Output(std::ostream& os, opt_flush flush, std::size_t capacity)
+  : destination_{&os}
+  , flush_{flush}
+  , capacity_{capacity}
+{
+  buffer_.reserve(capacity_);
+}
+
+Output::~Output()
+{
+  try
+  {
+    flush();
+  }
+  catch (const std::system_error&)
+  {
+    // Nowhere to report it.
+  }
+}
+
+// ---------------------------------------------------------------------------------------------- //
+
+void
+Output::print(const Value& value)
+{
+  if (value.is<double>())
+  {
+    // Shortest round-trip representation, without going through the locale of a stream.
+    fmt::format_to(std::back_inserter(buffer_), "{}", value.unchecked_as<double>());
+  }
+  else if (value.is<bool>())
+  {
+    buffer_ += value.unchecked_as<bool>() ? "true" : "false";
+  }
+  else if (value.is<Nil>())
+  {
+    buffer_ += "nil";
+  }
+  else if (value.is<const ObjString*>())
+  {
+    buffer_ += value.unchecked_as<const ObjString*>()->str();
+  }
+  else
+  {
+    // Ropes are appended part by part, without being flattened.
+    value.unchecked_as<const ObjRope*>()->append_to(buffer_);
+  }
+  end_line();
+}
+
+void
+Output::write_line(std::string_view line)
+{
+  buffer_ += line;
+  end_line();
+}
+
+void
+Output::end_line()
+{
+  buffer_ += '\n';
+  if (flush_ == opt_flush::line or (flush_ == opt_flush::size and buffer_.size() >= capacity_))
+  {
+    flush();
+  }
+}
+
+// ---------------------------------------------------------------------------------------------- //
+
+void
+Output::flush()
+{
+  if (buffer_.empty())
+  {
+    return;
+  }
+
+  std::visit(
+    detail::visitor{[this](int fd)
+                    {
+                      auto rest = std::string_view{buffer_};
+                      while (not rest.empty())
+                      {
+                        const auto written = ::write(fd, rest.data(), rest.size());
+                        if (written < 0 and errno != EINTR)
+                        {
+                          const auto error = errno;
+                          buffer_.clear();
+                          throw std::system_error{error, std::generic_category(), "write"};
+                        }
+                        rest.remove_prefix(written < 0 ? 0 : static_cast<std::size_t>(written));
+                      }
+                    },
+                    [this](std::ostream* os)
+                    { os->write(buffer_.data(), static_cast<std::streamsize>(buffer_.size())); }},
+    destination_);
+  buffer_.clear();
+}
+
+// ---------------------------------------------------------------------------------------------- //
+
+Output&
+standard_output()
+{
+  static auto output = Output{STDOUT_FILENO,
+                              ::isatty(STDOUT_FILENO) != 0 ? Output::opt_flush::line
+                                                           : Output::opt_flush::size};
+  return output;
+}
+
+// ---------------------------------------------------------------------------------------------- //
+
+} // namespace clox
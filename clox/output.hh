@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+#include <string_view>
+#include <variant>
+
+#include "clox/value.hh"
+
+namespace clox {
+
+// ---------------------------------------------------------------------------------------------- //
+
+// Where the VM prints values. They are formatted into a buffer, which is written to a file
+// descriptor with write(2), or to a stream, according to a flush policy.
+class Output
+{
+public:
+  enum class opt_flush
+  {
+    // At the end of each line, for interactive sessions.
+    line,
+    // When the buffer is full.
+    size,
+    // Only when asked to, which the VM does when the execution of a chunk ends.
+    exit
+  };
+
+  static constexpr std::size_t default_capacity = std::size_t{64} * 1024;
+
+public:
+  // Write to `fd`, which is not closed.
+  explicit Output(int fd,
+                  opt_flush flush = opt_flush::size,
+                  std::size_t capacity = default_capacity);
+
+  // Write to `os`, which must outlive the output.
+  explicit Output(std::ostream& os,
+                  opt_flush flush = opt_flush::size,
+                  std::size_t capacity = default_capacity);
+
+  // Write what remains in the buffer, ignoring errors.
+  ~Output();
+  Output(const Output&) = delete;
+  Output(Output&&) = delete;
+  Output& operator=(const Output&) = delete;
+  Output& operator=(Output&&) = delete;
+
+  // Print `value` on its own line. Numbers are printed with the shortest representation which
+  // reads back to the same number.
+  void print(const Value& value);
+
+  // Write `line`, followed by a newline.
+  void write_line(std::string_view line);
+
+  // Throw std::system_error if the file descriptor can't be written.
+  void flush();
+
+private:
+  void end_line();
+
+private:
+  std::variant<int, std::ostream*> destination_;
+  opt_flush flush_;
+  std::size_t capacity_;
+  std::string buffer_{};
+};
+
+// ---------------------------------------------------------------------------------------------- //
+
+// Output to the standard output, flushed at each line if it's a terminal. Written when the program
+// exits, unless flushed before.
+[[nodiscard]] Output&
+standard_output();
+
+// ---------------------------------------------------------------------------------------------- //
+
+} // namespace clox
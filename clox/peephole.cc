@@ -0,0 +1,177 @@
+#include <optional>
+#include <vector>
+
+#include "clox/detail/visitor.hh"
+#include "clox/peephole.hh"
+
+namespace clox {
+
+// ---------------------------------------------------------------------------------------------- //
+
+namespace /* anonymous */ {
+
+using Instructions = std::vector<Instruction>;
+using SourceOffset = std::optional<std::size_t>;
+
+// If `opcode` has no other effect than pushing a single value, return how many values it pops.
+std::optional<std::size_t>
+pure_pops(const Opcode& opcode)
+{
+  return std::visit(
+    [](const auto& op) -> std::optional<std::size_t>
+    {
+      using Op = std::decay_t<decltype(op)>;
+
+      if constexpr (std::is_same_v<Op, OpConstant> or std::is_same_v<Op, OpFalse> or
+                    std::is_same_v<Op, OpNil> or std::is_same_v<Op, OpTrue> or
+                    std::is_same_v<Op, OpNot> or std::is_same_v<Op, OpEqual> or
+                    std::is_same_v<Op, OpGreater> or std::is_same_v<Op, OpLess> or
+                    std::is_same_v<Op, OpNotEqual> or std::is_same_v<Op, OpNotGreater> or
+                    std::is_same_v<Op, OpNotLess> or std::is_same_v<Op, OpGetGlobalVarUnchecked> or
+                    std::is_same_v<Op, OpConstantLong> or
+                    std::is_same_v<Op, OpGetGlobalVarUncheckedLong>)
+      {
+        return Op::pops;
+      }
+      else
+      {
+        return {};
+      }
+    },
+    opcode);
+}
+
+// Pop `nb` values, removing the preceding pure instructions which produced them.
+void
+pop(Instructions& out, std::size_t nb, SourceOffset source_offset)
+{
+  while (nb > 0 and not out.empty())
+  {
+    if (const auto pops = pure_pops(out.back().opcode))
+    {
+      nb = nb - 1 + *pops;
+      out.pop_back();
+    }
+    else if (std::holds_alternative<OpPop<1>>(out.back().opcode))
+    {
+      nb += 1;
+      out.pop_back();
+    }
+    else
+    {
+      break;
+    }
+  }
+
+  for (; nb >= 2; nb -= 2)
+  {
+    out.push_back({OpPop<2>{}, source_offset});
+  }
+  if (nb == 1)
+  {
+    out.push_back({OpPop<1>{}, source_offset});
+  }
+}
+
+// Fuse OP_NOT with the preceding comparison.
+bool
+fuse_not(Instructions& out, SourceOffset source_offset)
+{
+  if (out.empty())
+  {
+    return false;
+  }
+
+  const auto negated =
+    std::visit(detail::visitor{[](OpEqual) -> Opcode { return OpNotEqual{}; },
+                               [](OpGreater) -> Opcode { return OpNotGreater{}; },
+                               [](OpLess) -> Opcode { return OpNotLess{}; },
+                               [](OpNotEqual) -> Opcode { return OpEqual{}; },
+                               [](OpNotGreater) -> Opcode { return OpGreater{}; },
+                               [](OpNotLess) -> Opcode { return OpLess{}; },
+                               [](const auto&) -> Opcode { return OpNot{}; }},
+               out.back().opcode);
+
+  if (std::holds_alternative<OpNot>(negated))
+  {
+    return false;
+  }
+
+  out.back() = {negated, source_offset};
+  return true;
+}
+
+// Fuse an arithmetic operator with the preceding instruction, if it loads its right operand. Only
+// the short forms of loads are fused, the long ones being rare.
+template<typename Impl>
+bool
+fuse_operand(Instructions& out, SourceOffset source_offset)
+{
+  if (out.empty())
+  {
+    return false;
+  }
+
+  if (const auto* op = std::get_if<OpConstant>(&out.back().opcode))
+  {
+    out.back() = {OpBinaryConstant<Impl>{op->constant}, source_offset};
+    return true;
+  }
+  else if (const auto* op = std::get_if<OpGetGlobalVar>(&out.back().opcode))
+  {
+    out.back() = {OpBinaryGlobal<Impl>{op->global_variable_index}, source_offset};
+    return true;
+  }
+  else if (const auto* op = std::get_if<OpGetGlobalVarUnchecked>(&out.back().opcode))
+  {
+    out.back() = {OpBinaryGlobalUnchecked<Impl>{op->global_variable_index}, source_offset};
+    return true;
+  }
+  else
+  {
+    return false;
+  }
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------------------------- //
+
+void
+peephole(Code& code)
+{
+  auto out = Instructions{};
+
+  for (const auto& instruction : code.instructions())
+  {
+    const auto source_offset = instruction.source_offset;
+    const auto rewrite = detail::visitor{
+      [&](OpAdd) { return fuse_operand<OpAddImpl>(out, source_offset); },
+      [&](OpDivide) { return fuse_operand<OpDivideImpl>(out, source_offset); },
+      [&](OpMultiply) { return fuse_operand<OpMultiplyImpl>(out, source_offset); },
+      [&](OpSubtract) { return fuse_operand<OpSubtractImpl>(out, source_offset); },
+      [&](OpNot) { return fuse_not(out, source_offset); },
+      [&](OpPop<1>)
+      {
+        pop(out, 1, source_offset);
+        return true;
+      },
+      [&](OpPop<2>)
+      {
+        pop(out, 2, source_offset);
+        return true;
+      },
+      [](const auto&) { return false; }};
+
+    if (not std::visit(rewrite, instruction.opcode))
+    {
+      out.push_back(instruction);
+    }
+  }
+
+  code.set_instructions(out);
+}
+
+// ---------------------------------------------------------------------------------------------- //
+
+} // namespace clox
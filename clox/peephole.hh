@@ -0,0 +1,21 @@
+#pragma once
+
+#include "clox/code.hh"
+
+namespace clox {
+
+// ---------------------------------------------------------------------------------------------- //
+
+// Replace common sequences of instructions by superinstructions:
+//   - a comparison followed by OP_NOT becomes a single negated comparison;
+//   - an arithmetic operator whose right operand is a constant or a global variable becomes a
+//     single instruction with this operand;
+//   - pure instructions whose result is immediately popped are removed, and consecutive pops are
+//     merged.
+// The sequences to fuse were chosen from the bigrams and trigrams reported by clox_profile.
+void
+peephole(Code&);
+
+// ---------------------------------------------------------------------------------------------- //
+
+} // namespace clox
@@ -0,0 +1,92 @@
+#include <algorithm>
+#include <ostream>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "clox/profile.hh"
+
+namespace clox {
+
+// ---------------------------------------------------------------------------------------------- //
+
+namespace /* anonymous */ {
+
+template<std::size_t N>
+void
+report_ngrams(std::ostream& os,
+              const std::map<std::array<std::uint8_t, N>, std::size_t>& ngrams,
+              std::size_t nb)
+{
+  auto sorted = std::vector<std::pair<std::array<std::uint8_t, N>, std::size_t>>{ngrams.cbegin(),
+                                                                                 ngrams.cend()};
+  std::stable_sort(sorted.begin(),
+                   sorted.end(),
+                   [](const auto& lhs, const auto& rhs) { return lhs.second > rhs.second; });
+  sorted.resize(std::min(nb, sorted.size()));
+
+  for (const auto& [ngram, count] : sorted)
+  {
+    os << fmt::format("{:>10}", count);
+    for (const auto opcode : ngram)
+    {
+      os << ' ' << opcode_names[opcode];
+    }
+    os << '\n';
+  }
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------------------------- //
+
+void
+OpcodeProfile::record(const Code& code)
+{
+  auto window = std::array<std::uint8_t, 3>{};
+  auto nb_seen = std::size_t{0};
+
+  for (auto it = code.cbegin(); it != code.cend(); it = Code::next(it))
+  {
+    window = {window[1], window[2], *it};
+    ++nb_seen;
+
+    if (nb_seen >= 2)
+    {
+      ++bigrams_[{window[1], window[2]}];
+    }
+    if (nb_seen >= 3)
+    {
+      ++trigrams_[window];
+    }
+  }
+}
+
+// ---------------------------------------------------------------------------------------------- //
+
+const std::map<OpcodeProfile::Bigram, std::size_t>&
+OpcodeProfile::bigrams() const noexcept
+{
+  return bigrams_;
+}
+
+const std::map<OpcodeProfile::Trigram, std::size_t>&
+OpcodeProfile::trigrams() const noexcept
+{
+  return trigrams_;
+}
+
+// ---------------------------------------------------------------------------------------------- //
+
+void
+OpcodeProfile::report(std::ostream& os, std::size_t nb) const
+{
+  os << "Bigrams:\n";
+  report_ngrams(os, bigrams_, nb);
+  os << "Trigrams:\n";
+  report_ngrams(os, trigrams_, nb);
+}
+
+// ---------------------------------------------------------------------------------------------- //
+
+} // namespace clox
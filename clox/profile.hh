@@ -0,0 +1,39 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <iosfwd>
+#include <map>
+
+#include "clox/code.hh"
+
+namespace clox {
+
+// ---------------------------------------------------------------------------------------------- //
+
+// Count sequences of two and three consecutive opcodes, to find candidates for superinstructions.
+// As code has no control flow yet, the sequences found in the bytecode are exactly the ones
+// executed by the VM.
+class OpcodeProfile
+{
+public:
+  using Bigram = std::array<std::uint8_t, 2>;
+  using Trigram = std::array<std::uint8_t, 3>;
+
+public:
+  void record(const Code&);
+
+  [[nodiscard]] const std::map<Bigram, std::size_t>& bigrams() const noexcept;
+  [[nodiscard]] const std::map<Trigram, std::size_t>& trigrams() const noexcept;
+
+  // Print the `nb` most frequent bigrams and trigrams.
+  void report(std::ostream&, std::size_t nb) const;
+
+private:
+  std::map<Bigram, std::size_t> bigrams_{};
+  std::map<Trigram, std::size_t> trigrams_{};
+};
+
+// ---------------------------------------------------------------------------------------------- //
+
+} // namespace clox
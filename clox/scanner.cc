@@ -1,5 +1,10 @@
-#include <unordered_map>
+#include <algorithm>
+#include <exception>
+#include <thread>
+#include <utility>
+#include <vector>
 
+#include "clox/detail/scan.hh"
 #include "clox/scanner.hh"
 
 // ---------------------------------------------------------------------------------------------- //
@@ -11,68 +16,276 @@ namespace clox {
 namespace /* anonymous */
 {
 
-[[nodiscard]] bool
-is_digit(char c) noexcept
-{
-  return c >= '0' and c <= '9';
-}
+using detail::is_alpha;
+using detail::is_digit;
 
-[[nodiscard]] bool
-is_alpha(char c) noexcept
+[[nodiscard]] constexpr TokenType
+check_keyword(std::string_view str,
+              std::size_t start,
+              std::string_view rest,
+              TokenType type) noexcept
 {
-  return (c >= 'a' and c <= 'z') or (c >= 'A' and c <= 'Z') or c == '_';
+  return str.substr(start) == rest ? type : TokenType::identifier;
 }
 
-[[nodiscard]] TokenType
-identifier_type(const std::string_view& str)
+// Keywords are recognized by a trie of switches on their first characters, followed by a
+// comparison of their remaining characters. Precondition: not str.empty().
+[[nodiscard]] constexpr TokenType
+identifier_type(std::string_view str) noexcept
 {
-  static const auto map =
-    std::unordered_map<std::string_view, TokenType>{{"and", TokenType::and_},
-                                                    {"class", TokenType::class_},
-                                                    {"else", TokenType::else_},
-                                                    {"false", TokenType::false_},
-                                                    {"false", TokenType::for_},
-                                                    {"false", TokenType::fun},
-                                                    {"if", TokenType::if_},
-                                                    {"nil", TokenType::nil},
-                                                    {"or", TokenType::or_},
-                                                    {"print", TokenType::print},
-                                                    {"return", TokenType::return_},
-                                                    {"super", TokenType::super},
-                                                    {"this", TokenType::this_},
-                                                    {"true", TokenType::true_},
-                                                    {"var", TokenType::var},
-                                                    {"while", TokenType::while_}};
-
-  if (const auto search = map.find(str); search != cend(map))
+  switch (str[0])
   {
-    return search->second;
+    case 'a':
+      return check_keyword(str, 1, "nd", TokenType::and_);
+    case 'c':
+      return check_keyword(str, 1, "lass", TokenType::class_);
+    case 'e':
+      return check_keyword(str, 1, "lse", TokenType::else_);
+    case 'f':
+      if (str.size() > 1)
+      {
+        switch (str[1])
+        {
+          case 'a':
+            return check_keyword(str, 2, "lse", TokenType::false_);
+          case 'o':
+            return check_keyword(str, 2, "r", TokenType::for_);
+          case 'u':
+            return check_keyword(str, 2, "n", TokenType::fun);
+          default:
+            break;
+        }
+      }
+      break;
+    case 'i':
+      return check_keyword(str, 1, "f", TokenType::if_);
+    case 'n':
+      return check_keyword(str, 1, "il", TokenType::nil);
+    case 'o':
+      return check_keyword(str, 1, "r", TokenType::or_);
+    case 'p':
+      return check_keyword(str, 1, "rint", TokenType::print);
+    case 'r':
+      return check_keyword(str, 1, "eturn", TokenType::return_);
+    case 's':
+      return check_keyword(str, 1, "uper", TokenType::super);
+    case 't':
+      if (str.size() > 1)
+      {
+        switch (str[1])
+        {
+          case 'h':
+            return check_keyword(str, 2, "is", TokenType::this_);
+          case 'r':
+            return check_keyword(str, 2, "ue", TokenType::true_);
+          default:
+            break;
+        }
+      }
+      break;
+    case 'v':
+      return check_keyword(str, 1, "ar", TokenType::var);
+    case 'w':
+      return check_keyword(str, 1, "hile", TokenType::while_);
+    default:
+      break;
   }
-  else
+  return TokenType::identifier;
+}
+
+static_assert(identifier_type("for") == TokenType::for_);
+static_assert(identifier_type("fun") == TokenType::fun);
+static_assert(identifier_type("false") == TokenType::false_);
+static_assert(identifier_type("this") == TokenType::this_);
+static_assert(identifier_type("f") == TokenType::identifier);
+static_assert(identifier_type("classes") == TokenType::identifier);
+
+// Split `source` into at most `nb_chunks` chunks of similar sizes. Each chunk but the first starts
+// right after a newline which is outside string literals and comments, so that scanning the chunks
+// on their own gives the same tokens as scanning the whole source. Only quotes and comments are
+// looked at, with memchr(), and newlines near the split points.
+std::vector<std::string_view>
+split(std::string_view source, std::size_t nb_chunks)
+{
+  constexpr auto npos = std::string_view::npos;
+
+  auto chunks = std::vector<std::string_view>{};
+  auto chunk_start = std::size_t{0};
+  // Outside string literals and comments.
+  auto pos = std::size_t{0};
+  // First quote and comment at or after `pos`.
+  auto next_quote = source.find('"');
+  auto next_comment = source.find("//");
+
+  while (chunks.size() + 1 < nb_chunks)
   {
-    return TokenType::identifier;
+    next_quote = next_quote < pos ? source.find('"', pos) : next_quote;
+    next_comment = next_comment < pos ? source.find("//", pos) : next_comment;
+    const auto next_special = std::min(next_quote, next_comment);
+
+    // Split at the first newline after the size of a chunk, unless it's in a string or a comment.
+    const auto target = chunk_start + (source.size() - chunk_start) / (nb_chunks - chunks.size());
+    if (const auto newline = source.find('\n', std::max(pos, target)); newline < next_special)
+    {
+      chunks.push_back(source.substr(chunk_start, newline + 1 - chunk_start));
+      chunk_start = pos = newline + 1;
+      continue;
+    }
+
+    if (next_special == npos)
+    {
+      break;
+    }
+    // Unterminated strings and comments go until the end of the source, in the last chunk.
+    const auto end = next_special == next_quote ? source.find('"', next_special + 1)
+                                                : source.find('\n', next_special);
+    if (end == npos)
+    {
+      break;
+    }
+    // The newline ending a comment is outside of it.
+    pos = next_special == next_quote ? end + 1 : end;
   }
+
+  chunks.push_back(source.substr(chunk_start));
+  return chunks;
 }
 
 } // namespace
 
 // ---------------------------------------------------------------------------------------------- //
 
-Scanner::Scanner(const std::string& str)
-  : current_{cbegin(str)}
-  , end_{cend(str)}
+Scanner::Scanner(std::string_view source)
+  : source_{source}
+  , begin_{source.data()}
+  , token_start_{source.data()}
+  , current_{source.data()}
+  , end_{source.data() + source.size()} // NOLINT(*-pointer-arithmetic)
+  , line_index_{std::make_shared<LineIndex>(source)}
 {}
 
+Scanner::Scanner(SourceReader reader, std::size_t chunk_size)
+  : line_index_{std::make_shared<LineIndex>()}
+  , stream_{std::make_unique<Stream>(std::move(reader), chunk_size)}
+{}
+
+Scanner
+Scanner::parallel(std::string_view source, std::size_t nb_threads, std::size_t min_chunk_size)
+{
+  const auto nb_chunks = std::min(source.size() / std::max(min_chunk_size, std::size_t{1}),
+                                  nb_threads);
+  if (nb_chunks <= 1)
+  {
+    return Scanner{source};
+  }
+
+  const auto chunks = split(source, nb_chunks);
+  auto scanned = std::make_shared<Scanned>();
+  scanned->chunks.resize(chunks.size());
+  auto eofs = std::vector<Token>(chunks.size());
+  auto errors = std::vector<std::exception_ptr>(chunks.size());
+  {
+    auto threads = std::vector<std::jthread>{};
+    threads.reserve(chunks.size());
+    for (auto i = std::size_t{0}; i < chunks.size(); ++i)
+    {
+      threads.emplace_back(
+        [&, i]
+        {
+          try
+          {
+            auto scanner = Scanner{chunks[i]};
+            // Offsets are counted from the start of the whole source.
+            scanner.begin_offset_ = static_cast<std::size_t>(chunks[i].data() - source.data());
+            auto& tokens = scanned->chunks[i];
+            // Typical sources have a token every 5 to 10 bytes.
+            tokens.reserve(chunks[i].size() / 8);
+            auto token = scanner.next_token();
+            for (; token.type != TokenType::eof; token = scanner.next_token())
+            {
+              tokens.push_back(token);
+            }
+            eofs[i] = token;
+          }
+          catch (...)
+          {
+            errors[i] = std::current_exception();
+          }
+        });
+    }
+  }
+  for (const auto& error : errors)
+  {
+    if (error)
+    {
+      std::rethrow_exception(error);
+    }
+  }
+
+  scanned->eof = eofs.back();
+
+  auto scanner = Scanner{source};
+  scanner.scanned_ = std::move(scanned);
+  return scanner;
+}
+
+// ---------------------------------------------------------------------------------------------- //
+
+std::optional<std::string_view>
+Scanner::source() const noexcept
+{
+  if (stream_)
+  {
+    return {};
+  }
+  return source_;
+}
+
+std::optional<Scanner>
+Scanner::rescan() const
+{
+  if (stream_)
+  {
+    return {};
+  }
+  auto scanner = Scanner{source_};
+  scanner.line_index_ = line_index_;
+  scanner.scanned_ = scanned_;
+  return scanner;
+}
+
+std::shared_ptr<const LineIndex>
+Scanner::line_index() const noexcept
+{
+  return line_index_;
+}
+
 // ---------------------------------------------------------------------------------------------- //
 
 Token
 Scanner::next_token()
 {
+  if (scanned_)
+  {
+    return next_scanned_token();
+  }
+
+  if (stream_)
+  {
+    // The caller is done with the token returned before the last one.
+    stream_->retired.clear();
+  }
+
   skip_whitespaces();
 
   token_start_ = current_;
 
-  if (current_ == end_)
+  if (offset() > max_source_offset) [[unlikely]]
+  {
+    return source_too_large();
+  }
+
+  if (at_end())
   {
     return make_token(TokenType::eof);
   }
@@ -134,14 +347,9 @@ Scanner::next_token()
 // ---------------------------------------------------------------------------------------------- //
 
 bool
-Scanner::match_equal() noexcept
+Scanner::match_equal()
 {
-  if (current_ == end_)
-  {
-    return false;
-  }
-
-  if (*current_ != '=')
+  if (peek() != '=')
   {
     return false;
   }
@@ -153,47 +361,132 @@ Scanner::match_equal() noexcept
 
 // ---------------------------------------------------------------------------------------------- //
 
+Token
+Scanner::next_scanned_token() noexcept
+{
+  for (; next_chunk_ < scanned_->chunks.size(); ++next_chunk_, next_token_ = 0)
+  {
+    if (const auto& tokens = scanned_->chunks[next_chunk_]; next_token_ < tokens.size())
+    {
+      return tokens[next_token_++];
+    }
+  }
+  return scanned_->eof;
+}
+
+// ---------------------------------------------------------------------------------------------- //
+
+// The source is not null-terminated: characters are only read after checking that they exist,
+// which is also when a streamed source is read further.
+
+bool
+Scanner::at_end()
+{
+  return current_ == end_ and not refill(1);
+}
+
+char
+Scanner::peek()
+{
+  return at_end() ? '\0' : *current_;
+}
+
 char
-Scanner::peek_next() const noexcept
+Scanner::peek_next()
 {
-  if (current_ == end_)
+  if (end_ - current_ < 2 and not refill(2))
   {
     return '\0';
   }
-  else
+  return *std::next(current_);
+}
+
+// ---------------------------------------------------------------------------------------------- //
+
+void
+Scanner::skip_run(const char* (*skip)(const char* first, const char* last), opt_keep keep)
+{
+  while ((current_ = skip(current_, end_)) == end_)
+  {
+    if (keep == opt_keep::no)
+    {
+      // A long comment or run of blanks is not copied to the next buffer.
+      token_start_ = current_;
+    }
+    if (not refill(1))
+    {
+      break;
+    }
+  }
+}
+
+bool
+Scanner::refill(std::size_t nb_bytes)
+{
+  if (not stream_)
+  {
+    return false;
+  }
+
+  auto& stream = *stream_;
+  while (static_cast<std::size_t>(end_ - current_) < nb_bytes and not stream.exhausted)
   {
-    return *(std::next(current_));
+    // The token being scanned is moved to a new buffer, followed by the next chunk. The chunk grows
+    // with the token, so that a long token is not copied over and over.
+    const auto kept = static_cast<std::size_t>(end_ - token_start_);
+    const auto chunk_size = std::max(stream.chunk_size, kept);
+    auto buffer = std::make_unique_for_overwrite<char[]>(kept + chunk_size); // NOLINT(*-c-arrays)
+    std::copy(token_start_, end_, buffer.get());
+
+    const auto nb_read = stream.reader(std::span{buffer.get() + kept, chunk_size});
+    if (nb_read == 0)
+    {
+      stream.exhausted = true;
+      break;
+    }
+
+    line_index_->add({buffer.get() + kept, nb_read}); // NOLINT(*-pointer-arithmetic)
+
+    // NOLINTBEGIN(*-pointer-arithmetic)
+    begin_offset_ += static_cast<std::size_t>(token_start_ - begin_);
+    begin_ = buffer.get();
+    current_ = buffer.get() + (current_ - token_start_);
+    end_ = buffer.get() + kept + nb_read;
+    // NOLINTEND(*-pointer-arithmetic)
+    token_start_ = buffer.get();
+    // The previous token may be in the old buffer: it's kept until the next call to next_token().
+    stream.retired.push_back(std::exchange(stream.buffer, std::move(buffer)));
   }
+
+  return static_cast<std::size_t>(end_ - current_) >= nb_bytes;
 }
 
 // ---------------------------------------------------------------------------------------------- //
 
 void
-Scanner::skip_whitespaces() noexcept
+Scanner::skip_whitespaces()
 {
   while (true)
   {
-    switch (*current_)
+    // Skipped characters don't need to be kept when a streamed source is read further.
+    token_start_ = current_;
+
+    switch (peek())
     {
       case ' ':
       case '\r':
       case '\t':
-        std::advance(current_, 1);
-        break;
-
       case '\n':
-        line_ += 1;
-        std::advance(current_, 1);
+        skip_run(&detail::skip_blanks, opt_keep::no);
         break;
 
       case '/':
         if (peek_next() == '/')
         {
           // A comment goes until the end of the line
-          while (current_ != end_ and *current_ != '\n')
-          {
-            std::advance(current_, 1);
-          }
+          skip_run([](const char* first, const char* last)
+                   { return detail::find(first, last, '\n'); },
+                   opt_keep::no);
         }
         else
         {
@@ -209,10 +502,18 @@ Scanner::skip_whitespaces() noexcept
 
 // ---------------------------------------------------------------------------------------------- //
 
+std::size_t
+Scanner::offset() const noexcept
+{
+  return begin_offset_ + static_cast<std::size_t>(token_start_ - begin_);
+}
+
+// ---------------------------------------------------------------------------------------------- //
+
 Token
 Scanner::make_token(TokenType type) const noexcept
 {
-  return Token{type, std::string_view{token_start_, current_}, line_};
+  return Token{type, std::string_view{token_start_, current_}, offset()};
 }
 
 // ---------------------------------------------------------------------------------------------- //
@@ -220,7 +521,7 @@ Scanner::make_token(TokenType type) const noexcept
 Token
 Scanner::make_token(TokenType type, const std::string_view& token) const noexcept
 {
-  return Token{type, token, line_};
+  return Token{type, token, offset()};
 }
 
 // ---------------------------------------------------------------------------------------------- //
@@ -234,18 +535,31 @@ Scanner::make_error_token(const std::string_view& msg) const noexcept
 // ---------------------------------------------------------------------------------------------- //
 
 Token
-Scanner::make_string_token() noexcept
+Scanner::source_too_large()
 {
-  while (current_ != end_ and *current_ != '"')
+  // Nothing more is read: offsets would not fit in tokens.
+  current_ = end_;
+  if (stream_)
   {
-    if (*current_ == '\n')
-    {
-      line_ += 1;
-    }
-    std::advance(current_, 1);
+    stream_->exhausted = true;
   }
 
-  if (current_ == end_)
+  if (std::exchange(too_large_, true))
+  {
+    return Token{TokenType::eof, {}, max_source_offset};
+  }
+  return Token{TokenType::error, "Source larger than 4 GiB", max_source_offset};
+}
+
+// ---------------------------------------------------------------------------------------------- //
+
+Token
+Scanner::make_string_token()
+{
+  // Strings can span several lines.
+  skip_run([](const char* first, const char* last) { return detail::find(first, last, '"'); });
+
+  if (at_end())
   {
     return make_error_token("Unterminated string");
   }
@@ -260,23 +574,17 @@ Scanner::make_string_token() noexcept
 // ---------------------------------------------------------------------------------------------- //
 
 Token
-Scanner::make_number_token() noexcept
+Scanner::make_number_token()
 {
-  while (is_digit(*current_))
-  {
-    std::advance(current_, 1);
-  }
+  skip_run(&detail::skip_digits);
 
   // Look for a fractional part.
-  if (*current_ == '.' and is_digit(peek_next()))
+  if (peek() == '.' and is_digit(peek_next()))
   {
     // Consume the dot.
     std::advance(current_, 1);
 
-    while (is_digit(*current_))
-    {
-      std::advance(current_, 1);
-    }
+    skip_run(&detail::skip_digits);
   }
 
   return make_token(TokenType::number);
@@ -285,12 +593,9 @@ Scanner::make_number_token() noexcept
 // ---------------------------------------------------------------------------------------------- //
 
 Token
-Scanner::make_identifier_token() noexcept
+Scanner::make_identifier_token()
 {
-  while (is_alpha(*current_) or is_digit(*current_))
-  {
-    std::advance(current_, 1);
-  }
+  skip_run(&detail::skip_identifier);
 
   return make_token(identifier_type({token_start_, current_}));
 }
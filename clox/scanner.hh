@@ -1,37 +1,138 @@
 #pragma once
 
 #include <cstddef>
-#include <string>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <span>
 #include <string_view>
+#include <vector>
 
 #include "clox/detail/token.hh"
+#include "clox/line_index.hh"
 
 namespace clox {
 
 // ---------------------------------------------------------------------------------------------- //
 
+// Read the next bytes of a source into the given buffer and return how many were read, 0 once the
+// whole source has been read.
+using SourceReader = std::function<std::size_t(std::span<char>)>;
+
+// ---------------------------------------------------------------------------------------------- //
+
 class Scanner
 {
 public:
-  explicit Scanner(const std::string&);
+  static constexpr std::size_t default_chunk_size = 64 * 1024;
+  // Smallest part of a source scanned by its own thread.
+  static constexpr std::size_t default_min_parallel_chunk_size = 1024 * 1024;
+
+public:
+  // Scan a source held in memory, e.g. a mapped file. Tokens view the source, which must outlive
+  // them.
+  explicit Scanner(std::string_view source);
+
+  // Scan a source read chunk by chunk, so that only the chunk being scanned is in memory. Tokens
+  // view an internal buffer: a token remains valid until next_token() has been called twice more,
+  // which is enough for a parser holding the current and previous tokens.
+  explicit Scanner(SourceReader reader, std::size_t chunk_size = default_chunk_size);
+
+  // Scan a source held in memory right away, on up to `nb_threads` threads. The source is split
+  // into chunks of at least `min_chunk_size` bytes, at newlines which are outside string literals
+  // and comments. Each chunk is scanned on its own thread, then next_token() returns the tokens of
+  // each chunk in turn.
+  [[nodiscard]] static Scanner
+  parallel(std::string_view source,
+           std::size_t nb_threads,
+           std::size_t min_chunk_size = default_min_parallel_chunk_size);
+
   Token next_token();
 
+  // The whole source, unless it's streamed.
+  [[nodiscard]] std::optional<std::string_view> source() const noexcept;
+
+  // Index of the lines of the source, to locate tokens. The index of a streamed source only covers
+  // what has been read so far.
+  [[nodiscard]] std::shared_ptr<const LineIndex> line_index() const noexcept;
+
+  // A scanner which starts again from the beginning of the source, unless it's streamed. Tokens
+  // scanned ahead of time are shared rather than scanned again.
+  [[nodiscard]] std::optional<Scanner> rescan() const;
+
 private:
+  // Offset in the source of the token being scanned.
+  [[nodiscard]] std::size_t offset() const noexcept;
   [[nodiscard]] Token make_token(TokenType) const noexcept;
   [[nodiscard]] Token make_token(TokenType, const std::string_view&) const noexcept;
   [[nodiscard]] Token make_error_token(const std::string_view&) const noexcept;
-  [[nodiscard]] Token make_string_token() noexcept;
-  [[nodiscard]] Token make_number_token() noexcept;
-  [[nodiscard]] Token make_identifier_token() noexcept;
-  [[nodiscard]] bool match_equal() noexcept;
-  [[nodiscard]] char peek_next() const noexcept;
-  void skip_whitespaces() noexcept;
+  // An error the first time, then the end of the source.
+  [[nodiscard]] Token source_too_large();
+  [[nodiscard]] Token make_string_token();
+  [[nodiscard]] Token make_number_token();
+  [[nodiscard]] Token make_identifier_token();
+  [[nodiscard]] bool match_equal();
+  [[nodiscard]] bool at_end();
+  [[nodiscard]] char peek();
+  [[nodiscard]] char peek_next();
+  void skip_whitespaces();
+
+  enum class opt_keep
+  {
+    // The run is part of the token being scanned.
+    yes,
+    // The run is skipped: it's dropped from the buffer when a streamed source is read further.
+    no
+  };
+
+  // Move current_ to the end of the run of characters found by `skip` in [first, last), reading a
+  // streamed source further while the run reaches the end of the buffer.
+  void skip_run(const char* (*skip)(const char* first, const char* last),
+                opt_keep keep = opt_keep::yes);
+
+  // Read from the stream until `nb_bytes` bytes are available from current_. Return false if the
+  // source ends before.
+  [[nodiscard]] bool refill(std::size_t nb_bytes);
 
 private:
-  std::string::const_iterator token_start_{};
-  std::string::const_iterator current_{};
-  const std::string::const_iterator end_{};
-  std::size_t line_{1};
+  struct Stream
+  {
+    SourceReader reader;
+    std::size_t chunk_size;
+    std::unique_ptr<char[]> buffer{}; // NOLINT(*-avoid-c-arrays)
+    // Buffers replaced during the current call to next_token(), which may hold the token returned
+    // by the previous call.
+    std::vector<std::unique_ptr<char[]>> retired{}; // NOLINT(*-avoid-c-arrays)
+    bool exhausted{false};
+  };
+
+  std::string_view source_{};
+  // Start of the source or of the buffer of a streamed source, and its offset in the source.
+  const char* begin_{nullptr};
+  std::size_t begin_offset_{0};
+  const char* token_start_{nullptr};
+  const char* current_{nullptr};
+  const char* end_{nullptr};
+  std::shared_ptr<LineIndex> line_index_{};
+  bool too_large_{false};
+
+  // Tokens of a source scanned ahead of time by parallel().
+  struct Scanned
+  {
+    // Tokens of each chunk of the source, without their final eof token.
+    std::vector<std::vector<Token>> chunks;
+    Token eof;
+  };
+
+  [[nodiscard]] Token next_scanned_token() noexcept;
+
+  // Only for streamed sources.
+  std::unique_ptr<Stream> stream_{};
+
+  // Only for sources scanned ahead of time.
+  std::shared_ptr<const Scanned> scanned_{};
+  std::size_t next_chunk_{0};
+  std::size_t next_token_{0};
 };
 
 // ---------------------------------------------------------------------------------------------- //
@@ -0,0 +1,226 @@
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <istream>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+#include <fmt/core.h>
+
+#include "clox/detail/hash.hh"
+#include "clox/disassemble.hh"
+#include "clox/trace.hh"
+
+namespace clox {
+
+// ---------------------------------------------------------------------------------------------- //
+
+namespace /* anonymous */ {
+
+// A trace is a header followed by events, in the native byte order.
+
+constexpr auto file_magic = std::to_array<char>({'C', 'L', 'O', 'X', 'T', '\0', '\0', '\0'});
+// Bump when the layout of the header or of events changes.
+constexpr std::uint32_t format_version = 2;
+
+struct Header
+{
+  std::array<char, file_magic.size()> magic;
+  std::uint32_t version;
+  // Events start after the header.
+  std::uint32_t header_size;
+  std::uint32_t event_size;
+  Tracer::opt_streamed streamed;
+  std::uint64_t code_hash;
+};
+
+static_assert(sizeof(Header) == 32);
+
+// Identify the traced code by its bytecode and its constants, so that a trace is not decoded with
+// a script edited since.
+std::uint64_t
+hash(const Code& code)
+{
+  const auto bytecode = code.bytecode();
+  // NOLINTNEXTLINE(*-reinterpret-cast)
+  const auto seed = detail::hash({reinterpret_cast<const char*>(bytecode.data()), bytecode.size()});
+  auto constants = std::ostringstream{};
+  for (const auto constant : code.constants())
+  {
+    constants << constant << '\n';
+  }
+  return detail::hash(constants.view(), seed);
+}
+
+// How often the writer runs when the ring buffer is not full.
+constexpr auto writer_period = std::chrono::milliseconds{1};
+
+} // namespace
+
+// ---------------------------------------------------------------------------------------------- //
+
+Tracer::Tracer(std::ostream& os, opt_streamed streamed, std::size_t capacity)
+  : os_{os}
+  , streamed_{streamed}
+  , events_(std::bit_ceil(std::max(capacity, std::size_t{1})))
+  , mask_{events_.size() - 1}
+{
+  writer_ = std::jthread{[this](std::stop_token stop) { write(std::move(stop)); }};
+}
+
+Tracer::~Tracer()
+{
+  writer_.request_stop();
+  writer_.join();
+  os_.flush();
+}
+
+void
+Tracer::start(const Code& code)
+{
+  if (&code == code_)
+  {
+    return;
+  }
+  const auto code_hash = hash(code);
+  if (not code_hash_)
+  {
+    // The writer doesn't write to the stream before the first event.
+    const auto header =
+      Header{file_magic, format_version, sizeof(Header), sizeof(TraceEvent), streamed_, code_hash};
+    os_.write(reinterpret_cast<const char*>(&header), sizeof(header)); // NOLINT(*-reinterpret-cast)
+    code_hash_ = code_hash;
+  }
+  else if (*code_hash_ != code_hash)
+  {
+    throw std::logic_error{"A tracer records the runs of a single chunk"};
+  }
+  code_ = &code;
+}
+
+std::size_t
+Tracer::nb_events() const noexcept
+{
+  return head_.load(std::memory_order_relaxed);
+}
+
+// ---------------------------------------------------------------------------------------------- //
+
+void
+Tracer::wait_for_room(std::size_t head) noexcept
+{
+  {
+    const auto lock = std::scoped_lock{mutex_};
+    full_ = true;
+  }
+  wake_writer_.notify_one();
+
+  while (head - (cached_tail_ = tail_.load(std::memory_order_acquire)) == events_.size())
+  {
+    tail_.wait(cached_tail_, std::memory_order_acquire);
+  }
+}
+
+void
+Tracer::write(std::stop_token stop)
+{
+  auto lock = std::unique_lock{mutex_};
+  while (not stop.stop_requested())
+  {
+    wake_writer_.wait_for(lock, stop, writer_period, [this] { return full_; });
+    full_ = false;
+    lock.unlock();
+    write_available();
+    lock.lock();
+  }
+  lock.unlock();
+  // The VM thread has stopped recording.
+  write_available();
+}
+
+void
+Tracer::write_available()
+{
+  const auto tail = tail_.load(std::memory_order_relaxed);
+  const auto head = head_.load(std::memory_order_acquire);
+  if (head == tail)
+  {
+    return;
+  }
+
+  // The events may wrap around the end of the buffer.
+  const auto write_range = [this](std::size_t first, std::size_t last)
+  {
+    // NOLINTNEXTLINE(*-reinterpret-cast)
+    os_.write(reinterpret_cast<const char*>(events_.data() + first),
+              static_cast<std::streamsize>((last - first) * sizeof(TraceEvent)));
+  };
+  const auto first = tail & mask_;
+  const auto last = head & mask_;
+  if (first < last)
+  {
+    write_range(first, last);
+  }
+  else
+  {
+    write_range(first, events_.size());
+    write_range(0, last);
+  }
+
+  tail_.store(head, std::memory_order_release);
+  tail_.notify_one();
+}
+
+// ---------------------------------------------------------------------------------------------- //
+
+RecordedTrace
+read_trace(std::istream& is)
+{
+  auto header = Header{};
+  is.read(reinterpret_cast<char*>(&header), sizeof(header)); // NOLINT(*-reinterpret-cast)
+  if (not is or header.magic != file_magic or header.version != format_version or
+      header.header_size != sizeof(Header) or header.event_size != sizeof(TraceEvent))
+  {
+    throw std::runtime_error{"Not a trace of this version of clox"};
+  }
+
+  auto events = std::vector<TraceEvent>{};
+  auto event = TraceEvent{};
+  while (is.read(reinterpret_cast<char*>(&event), sizeof(event))) // NOLINT(*-reinterpret-cast)
+  {
+    events.push_back(event);
+  }
+  if (is.gcount() != 0)
+  {
+    throw std::runtime_error{"Truncated trace"};
+  }
+  return {header.streamed, header.code_hash, std::move(events)};
+}
+
+void
+decode_trace(const RecordedTrace& trace, const Chunk& chunk, std::ostream& os)
+{
+  const auto& code = *chunk.code;
+  if (hash(code) != trace.code_hash)
+  {
+    throw std::runtime_error{"The trace was recorded from another bytecode or other constants"};
+  }
+  for (const auto& event : trace.events)
+  {
+    if (event.offset >= code.size() or code.bytecode()[event.offset] != event.opcode)
+    {
+      throw std::runtime_error{
+        fmt::format("Instruction at offset {} is not in the traced chunk", event.offset)};
+    }
+    os << disassemble(std::next(code.cbegin(), event.offset), chunk) << '\n';
+  }
+}
+
+// ---------------------------------------------------------------------------------------------- //
+
+} // namespace clox
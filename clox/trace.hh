@@ -0,0 +1,140 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+#include "clox/chunk.hh"
+
+namespace clox {
+
+// ---------------------------------------------------------------------------------------------- //
+
+// An instruction executed by the VM.
+struct TraceEvent
+{
+  // Offset of the instruction in the bytecode.
+  std::uint32_t offset;
+  // Depth of the stack before the instruction, saturated.
+  std::uint32_t stack_depth : 24;
+  std::uint32_t opcode : 8;
+
+  friend bool operator==(const TraceEvent&, const TraceEvent&) = default;
+};
+
+static_assert(sizeof(TraceEvent) == 8);
+
+// ---------------------------------------------------------------------------------------------- //
+
+// Record executed instructions with little overhead: the VM writes compact binary events to a
+// ring buffer, which a background thread writes to a stream. The trace is decoded later, with the
+// chunk it was recorded from, by decode_trace().
+class Tracer
+{
+public:
+  // Whether the traced chunk is compiled from a streamed source, which the compiler doesn't
+  // optimize as much: it must be compiled the same way to decode the trace.
+  enum class opt_streamed : std::uint32_t
+  {
+    no,
+    yes
+  };
+
+  // Number of events of the ring buffer, a power of two.
+  static constexpr std::size_t default_capacity = std::size_t{1} << 16U;
+
+public:
+  // Write the events to `os` as they are recorded, after a header written by start(). `os` must
+  // outlive the tracer.
+  explicit Tracer(std::ostream& os,
+                  opt_streamed streamed = opt_streamed::no,
+                  std::size_t capacity = default_capacity);
+
+  // Write the events which remain in the ring buffer.
+  ~Tracer();
+  Tracer(const Tracer&) = delete;
+  Tracer(Tracer&&) = delete;
+  Tracer& operator=(const Tracer&) = delete;
+  Tracer& operator=(Tracer&&) = delete;
+
+  // Called by the VM thread only. If the ring buffer is full, wake the writer up and wait for it,
+  // so that no event is lost.
+  void record(TraceEvent event) noexcept
+  {
+    const auto head = head_.load(std::memory_order_relaxed);
+    if (head - cached_tail_ == events_.size()) [[unlikely]]
+    {
+      wait_for_room(head);
+    }
+    events_[head & mask_] = event;
+    head_.store(head + 1, std::memory_order_release);
+  }
+
+  // Called by the VM before running `code`. The first call writes the header, which identifies
+  // `code`. A tracer records the runs of a single chunk: throw std::logic_error if `code` has
+  // another bytecode or other constants.
+  void start(const Code& code);
+
+  [[nodiscard]] std::size_t nb_events() const noexcept;
+
+private:
+  [[gnu::cold, gnu::noinline]] void wait_for_room(std::size_t head) noexcept;
+  void write(std::stop_token);
+  // Write the events recorded since the last call.
+  void write_available();
+
+private:
+  std::ostream& os_;
+  opt_streamed streamed_;
+  // Of the traced code, once started. The code is only hashed when it changes.
+  const Code* code_{nullptr};
+  std::optional<std::uint64_t> code_hash_{};
+  std::vector<TraceEvent> events_;
+  std::size_t mask_;
+
+  // Written by the VM thread.
+  alignas(64) std::atomic<std::size_t> head_{0};
+  // Last value of tail_ seen by the VM thread.
+  std::size_t cached_tail_{0};
+  // Written by the writer thread.
+  alignas(64) std::atomic<std::size_t> tail_{0};
+
+  // The writer runs periodically, or as soon as the VM thread finds the ring buffer full.
+  std::mutex mutex_;
+  std::condition_variable_any wake_writer_;
+  bool full_{false};
+
+  // Started last, once the buffer is ready.
+  std::jthread writer_;
+};
+
+// ---------------------------------------------------------------------------------------------- //
+
+// A trace written by a Tracer.
+struct RecordedTrace
+{
+  Tracer::opt_streamed streamed;
+  // Of the bytecode and constants of the traced chunk.
+  std::uint64_t code_hash;
+  std::vector<TraceEvent> events;
+};
+
+// Read a trace written by a Tracer. Throw std::runtime_error if it's not a trace.
+[[nodiscard]] RecordedTrace
+read_trace(std::istream&);
+
+// Write `trace`, recorded while executing `chunk`, to `os`, with one disassembled instruction per
+// line. Throw std::runtime_error if the trace was recorded from another bytecode or constants.
+void
+decode_trace(const RecordedTrace& trace, const Chunk& chunk, std::ostream& os);
+
+// ---------------------------------------------------------------------------------------------- //
+
+} // namespace clox
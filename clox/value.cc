@@ -1,36 +1,43 @@
+#include <ostream>
+
+#include <fmt/format.h>
+
 #include "clox/value.hh"
-#include "clox/detail/visitor.hh"
 
 namespace clox {
 
 // ---------------------------------------------------------------------------------------------- //
 
-Value::Value(Nil)
-  : value_(Nil{})
-{}
+namespace /* anonymous */ {
+
+// Compare strings which may be ropes by content.
+std::strong_ordering
+compare_strings(const Value& lhs, const Value& rhs)
+{
+  const auto flatten = [](const Value& value)
+  {
+    return value.is<const ObjString*>() ? std::string{value.unchecked_as<const ObjString*>()->str()}
+                                        : value.unchecked_as<const ObjRope*>()->str();
+  };
+  return flatten(lhs) <=> flatten(rhs);
+}
 
-Value::Value(double d)
-  : value_{d}
-{}
+} // namespace
 
-Value::Value(bool b)
-  : value_{b}
-{}
+// ---------------------------------------------------------------------------------------------- //
 
-Value::Value(const ObjString* obj)
-  : value_{obj}
-{}
+void
+Value::throw_bad_access(const Value& expected) const
+{
+  throw BadValueAccess{expected.type(), type()};
+}
 
 // ---------------------------------------------------------------------------------------------- //
 
 bool
-Value::falsey() const
+Value::falsey() const noexcept
 {
-  return std::visit(detail::visitor{[](bool b) { return not b; },
-                                    [](double) { return false; },
-                                    [](Nil) { return false; },
-                                    [](const ObjString*) { return false; }},
-                    value_);
+  return is<bool>() and not unchecked_as<bool>();
 }
 
 // ---------------------------------------------------------------------------------------------- //
@@ -38,24 +45,62 @@ Value::falsey() const
 bool
 operator==(const Value& lhs, const Value& rhs)
 {
-  return (lhs <=> rhs) == std::partial_ordering::equivalent;
+  if (lhs.is<double>() and rhs.is<double>())
+  {
+    return lhs.unchecked_as<double>() == rhs.unchecked_as<double>();
+  }
+#if CLOX_NAN_BOXING
+  else if (lhs.is<const ObjRope*>() or rhs.is<const ObjRope*>()) [[unlikely]]
+  {
+    return lhs.is_string() and rhs.is_string() and compare_strings(lhs, rhs) == 0;
+  }
+  // Nil, booleans and strings are equal if and only if they have the same representation, as
+  // strings are interned.
+  return lhs.bits_ == rhs.bits_;
+#else
+  else if (lhs.is<const ObjString*>() and rhs.is<const ObjString*>())
+  {
+    // Strings are interned by Memory: equal strings are the same object.
+    return lhs.unchecked_as<const ObjString*>() == rhs.unchecked_as<const ObjString*>();
+  }
+  else
+  {
+    return (lhs <=> rhs) == std::partial_ordering::equivalent;
+  }
+#endif
 }
 
 std::partial_ordering
 operator<=>(const Value& lhs, const Value& rhs)
 {
-  return std::visit(
-    detail::visitor{
-      [](bool lhs, bool rhs) -> std::partial_ordering
-      { return lhs == rhs ? std::partial_ordering::equivalent : std::partial_ordering::unordered; },
-      [](double lhs, double rhs) -> std::partial_ordering { return lhs <=> rhs; },
-      [](Nil, Nil) -> std::partial_ordering { return std::partial_ordering::equivalent; },
-      [](const ObjString* lhs, const ObjString* rhs) -> std::partial_ordering
-      { return *lhs <=> *rhs; },
-      [](const auto&, const auto&) -> std::partial_ordering
-      { return std::partial_ordering::unordered; }},
-    lhs.value_,
-    rhs.value_);
+  if (lhs.is<double>() and rhs.is<double>())
+  {
+    return lhs.unchecked_as<double>() <=> rhs.unchecked_as<double>();
+  }
+  else if (lhs.is<bool>() and rhs.is<bool>())
+  {
+    return lhs.unchecked_as<bool>() == rhs.unchecked_as<bool>()
+             ? std::partial_ordering::equivalent
+             : std::partial_ordering::unordered;
+  }
+  else if (lhs.is<Nil>() and rhs.is<Nil>())
+  {
+    return std::partial_ordering::equivalent;
+  }
+  else if (lhs.is<const ObjString*>() and rhs.is<const ObjString*>())
+  {
+    const auto* lhs_str = lhs.unchecked_as<const ObjString*>();
+    const auto* rhs_str = rhs.unchecked_as<const ObjString*>();
+    return lhs_str == rhs_str ? std::partial_ordering::equivalent : *lhs_str <=> *rhs_str;
+  }
+  else if (lhs.is_string() and rhs.is_string())
+  {
+    return compare_strings(lhs, rhs);
+  }
+  else
+  {
+    return std::partial_ordering::unordered;
+  }
 }
 
 // ---------------------------------------------------------------------------------------------- //
@@ -63,11 +108,22 @@ operator<=>(const Value& lhs, const Value& rhs)
 std::string
 Value::type() const
 {
-  return std::visit(detail::visitor{[](bool) { return "boolean"; },
-                                    [](double) { return "number"; },
-                                    [](Nil) { return "nil"; },
-                                    [](const ObjString*) { return "string"; }},
-                    value_);
+  if (is<double>())
+  {
+    return "number";
+  }
+  else if (is<bool>())
+  {
+    return "boolean";
+  }
+  else if (is<Nil>())
+  {
+    return "nil";
+  }
+  else
+  {
+    return "string";
+  }
 }
 
 // ---------------------------------------------------------------------------------------------- //
@@ -75,11 +131,27 @@ Value::type() const
 std::ostream&
 operator<<(std::ostream& os, const Value& value)
 {
-  std::visit(detail::visitor{[&os](bool arg) { os << std::boolalpha << arg; },
-                             [&os](double arg) { os << arg; },
-                             [&os](Nil arg) { os << arg; },
-                             [&os](const ObjString* obj) { os << *obj; }},
-             value.value_);
+  // As printed by Output.
+  if (value.is<double>())
+  {
+    os << fmt::format("{}", value.unchecked_as<double>());
+  }
+  else if (value.is<bool>())
+  {
+    os << (value.unchecked_as<bool>() ? "true" : "false");
+  }
+  else if (value.is<Nil>())
+  {
+    os << Nil{};
+  }
+  else if (value.is<const ObjString*>())
+  {
+    os << *value.unchecked_as<const ObjString*>();
+  }
+  else
+  {
+    os << *value.unchecked_as<const ObjRope*>();
+  }
   return os;
 }
 
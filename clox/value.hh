@@ -1,14 +1,23 @@
 #pragma once
 
+#include <bit>
 #include <compare>
+#include <cstdint>
 #include <iosfwd>
+#include <type_traits>
 #include <variant>
 
 #include <fmt/ostream.h>
 
 #include "clox/nil.hh"
+#include "clox/obj_rope.hh"
 #include "clox/obj_string.hh"
 
+// Select the representation of values with the CLOX_NAN_BOXING CMake option.
+#ifndef CLOX_NAN_BOXING
+#define CLOX_NAN_BOXING 0
+#endif
+
 namespace clox {
 
 // ---------------------------------------------------------------------------------------------- //
@@ -28,52 +37,214 @@ struct BadValueAccess : public std::exception
 
 // ---------------------------------------------------------------------------------------------- //
 
+template<typename T>
+concept ValueType = std::is_same_v<T, double> or std::is_same_v<T, bool> or
+                    std::is_same_v<T, Nil> or std::is_same_v<T, const ObjString*> or
+                    std::is_same_v<T, const ObjRope*>;
+
+// ---------------------------------------------------------------------------------------------- //
+
 class Value
 {
-private:
-  std::variant<double, bool, Nil, const ObjString*> value_{Nil{}};
-
 public:
   Value() = default;
   // NOLINTBEGIN(hicpp-explicit-conversions)
-  Value(Nil);
-  Value(double);
-  Value(bool);
-  Value(const ObjString*);
+  Value(Nil) noexcept;
+  Value(double) noexcept;
+  Value(bool) noexcept;
+  Value(const ObjString*) noexcept;
+  Value(const ObjRope*) noexcept;
   // NOLINTEND(hicpp-explicit-conversions)
 
-  template<typename T>
+  template<ValueType T>
   [[nodiscard]] T as() const
   {
-    try
-    {
-      return std::get<T>(value_);
-    }
-    catch (const std::bad_variant_access&)
+    if (is<T>()) [[likely]]
     {
-      throw BadValueAccess{Value{T{}}.type(), type()};
+      return unchecked_as<T>();
     }
+    throw_bad_access(Value{T{}});
   }
 
-  template<typename T>
-  [[nodiscard]] bool is() const
-  {
-    return std::holds_alternative<T>(value_);
-  }
+  template<ValueType T>
+  [[nodiscard]] bool is() const noexcept;
+
+  // Precondition: is<T>().
+  template<ValueType T>
+  [[nodiscard]] T unchecked_as() const noexcept;
+
+  // Either a flat string or a rope.
+  [[nodiscard]] bool is_string() const noexcept;
 
-  [[nodiscard]] bool falsey() const;
+  [[nodiscard]] bool falsey() const noexcept;
 
+  // Strings must have been interned by Memory, so that they can be compared by identity. Ropes are
+  // compared by content, which is slower: Memory::intern() them first when comparing repeatedly.
   friend bool operator==(const Value&, const Value&);
+  // Strings are ordered by content.
   friend std::partial_ordering operator<=>(const Value&, const Value&);
 
   friend std::ostream& operator<<(std::ostream&, const Value&);
 
   [[nodiscard]] std::string type() const;
-  [[nodiscard]] const auto& value() const noexcept { return value_; }
+
+private:
+  [[noreturn, gnu::cold]] void throw_bad_access(const Value& expected) const;
+
+private:
+#if CLOX_NAN_BOXING
+  // Doubles are stored as is. Other values are stored in the payload of quiet NaNs, which are never
+  // produced by arithmetic operations: nil and booleans are distinguished by the lowest bits, and
+  // pointers to objects, which fit in 48 bits, have the sign bit set. As objects are aligned, the
+  // lowest bit of a pointer distinguishes ropes from strings.
+  static constexpr std::uint64_t sign_bit = 0x8000'0000'0000'0000;
+  static constexpr std::uint64_t quiet_nan = 0x7ffc'0000'0000'0000;
+  static constexpr std::uint64_t canonical_nan = 0x7ff8'0000'0000'0000;
+  static constexpr std::uint64_t nil_bits = quiet_nan | 1U;
+  static constexpr std::uint64_t false_bits = quiet_nan | 2U;
+  static constexpr std::uint64_t true_bits = quiet_nan | 3U;
+  static constexpr std::uint64_t object_bits = sign_bit | quiet_nan;
+  static constexpr std::uint64_t rope_bit = 1U;
+
+  std::uint64_t bits_{nil_bits};
+#else
+  std::variant<double, bool, Nil, const ObjString*, const ObjRope*> value_{Nil{}};
+#endif
 };
 
 // ---------------------------------------------------------------------------------------------- //
 
+#if CLOX_NAN_BOXING
+
+static_assert(sizeof(void*) == sizeof(std::uint64_t), "NaN boxing requires 64-bit pointers");
+
+inline Value::Value(Nil) noexcept
+  : bits_{nil_bits}
+{}
+
+inline Value::Value(double d) noexcept
+  // Make sure that a NaN resulting from a computation can't be mistaken for a boxed value.
+  : bits_{d == d ? std::bit_cast<std::uint64_t>(d) : canonical_nan}
+{}
+
+inline Value::Value(bool b) noexcept
+  : bits_{b ? true_bits : false_bits}
+{}
+
+inline Value::Value(const ObjString* obj) noexcept
+  : bits_{object_bits | reinterpret_cast<std::uintptr_t>(obj)}
+{}
+
+inline Value::Value(const ObjRope* obj) noexcept
+  : bits_{object_bits | reinterpret_cast<std::uintptr_t>(obj) | rope_bit}
+{}
+
+template<ValueType T>
+bool
+Value::is() const noexcept
+{
+  if constexpr (std::is_same_v<T, double>)
+  {
+    return (bits_ & quiet_nan) != quiet_nan;
+  }
+  else if constexpr (std::is_same_v<T, bool>)
+  {
+    return (bits_ | 1U) == true_bits;
+  }
+  else if constexpr (std::is_same_v<T, Nil>)
+  {
+    return bits_ == nil_bits;
+  }
+  else if constexpr (std::is_same_v<T, const ObjString*>)
+  {
+    return (bits_ & (object_bits | rope_bit)) == object_bits;
+  }
+  else
+  {
+    return (bits_ & (object_bits | rope_bit)) == (object_bits | rope_bit);
+  }
+}
+
+inline bool
+Value::is_string() const noexcept
+{
+  return (bits_ & object_bits) == object_bits;
+}
+
+template<ValueType T>
+T
+Value::unchecked_as() const noexcept
+{
+  if constexpr (std::is_same_v<T, double>)
+  {
+    return std::bit_cast<double>(bits_);
+  }
+  else if constexpr (std::is_same_v<T, bool>)
+  {
+    return bits_ == true_bits;
+  }
+  else if constexpr (std::is_same_v<T, Nil>)
+  {
+    return Nil{};
+  }
+  else if constexpr (std::is_same_v<T, const ObjString*>)
+  {
+    // NOLINTNEXTLINE(performance-no-int-to-ptr)
+    return reinterpret_cast<const ObjString*>(bits_ & ~object_bits);
+  }
+  else
+  {
+    // NOLINTNEXTLINE(performance-no-int-to-ptr)
+    return reinterpret_cast<const ObjRope*>(bits_ & ~(object_bits | rope_bit));
+  }
+}
+
+#else
+
+inline Value::Value(Nil) noexcept
+  : value_(Nil{})
+{}
+
+inline Value::Value(double d) noexcept
+  : value_{d}
+{}
+
+inline Value::Value(bool b) noexcept
+  : value_{b}
+{}
+
+inline Value::Value(const ObjString* obj) noexcept
+  : value_{obj}
+{}
+
+inline Value::Value(const ObjRope* obj) noexcept
+  : value_{obj}
+{}
+
+template<ValueType T>
+bool
+Value::is() const noexcept
+{
+  return std::holds_alternative<T>(value_);
+}
+
+template<ValueType T>
+T
+Value::unchecked_as() const noexcept
+{
+  return *std::get_if<T>(&value_);
+}
+
+inline bool
+Value::is_string() const noexcept
+{
+  return is<const ObjString*>() or is<const ObjRope*>();
+}
+
+#endif
+
+// ---------------------------------------------------------------------------------------------- //
+
 } // namespace clox
 
 template<>
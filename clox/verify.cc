@@ -0,0 +1,149 @@
+#include <algorithm>
+#include <array>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "clox/verify.hh"
+
+namespace clox {
+
+// ---------------------------------------------------------------------------------------------- //
+
+namespace /* anonymous */ {
+
+struct StackEffect
+{
+  std::size_t pops;
+  std::size_t pushes;
+};
+
+template<std::size_t... Is>
+constexpr auto
+make_stack_effects(std::index_sequence<Is...>)
+{
+  return std::array<StackEffect, sizeof...(Is)>{
+    StackEffect{std::variant_alternative_t<Is, Opcode>::pops,
+                std::variant_alternative_t<Is, Opcode>::pushes}...};
+}
+
+constexpr auto stack_effects =
+  make_stack_effects(std::make_index_sequence<std::variant_size_v<Opcode>>{});
+
+} // namespace
+
+// ---------------------------------------------------------------------------------------------- //
+
+VerifyResult
+verify(Chunk chunk)
+{
+  const auto& code = *chunk.code;
+  const auto nb_constants = code.nb_constants();
+  const auto nb_global_variables = chunk.memory->nb_global_variables();
+
+  const auto error = [&](Code::const_iterator cit, const std::string& msg)
+  {
+    return boost::leaf::new_error(
+      chunk.memory,
+      fmt::format("[offset {:04d}] Invalid bytecode: {}\n", code.code_offset(cit), msg));
+  };
+
+  const auto valid_operands = [&](const auto& op)
+  {
+    if constexpr (requires { op.constant; })
+    {
+      return detail::to_integer(op.constant) < nb_constants;
+    }
+    else if constexpr (requires { op.global_variable_index; })
+    {
+      return detail::to_integer(op.global_variable_index) < nb_global_variables;
+    }
+    else
+    {
+      return true;
+    }
+  };
+
+  // As there is no control flow, a variable is defined if it's been defined by a previous
+  // instruction.
+  auto defined_globals = std::vector<bool>(nb_global_variables, false);
+  const auto defined = [&](const auto& op)
+  {
+    using Op = std::decay_t<decltype(op)>;
+
+    if constexpr (std::is_same_v<Op, OpDefineGlobalVar> or
+                  std::is_same_v<Op, OpDefineGlobalVarLong>)
+    {
+      defined_globals[detail::to_integer(op.global_variable_index)] = true;
+      return true;
+    }
+    else if constexpr (requires { Op::assumes_defined; })
+    {
+      const auto index = detail::to_integer(op.global_variable_index);
+      return static_cast<bool>(defined_globals[index]);
+    }
+    else
+    {
+      return true;
+    }
+  };
+
+  auto depth = std::size_t{0};
+  auto max_depth = std::size_t{0};
+
+  for (auto cit = code.cbegin(); cit != code.cend(); cit = Code::next(cit))
+  {
+    if (*cit >= std::variant_size_v<Opcode>)
+    {
+      return error(cit, fmt::format("unknown opcode {}", *cit));
+    }
+
+    if (Code::instruction_size(cit) > static_cast<std::size_t>(std::distance(cit, code.cend())))
+    {
+      return error(cit, "truncated instruction");
+    }
+
+    const auto opcode = Code::decode(cit);
+
+    if (not std::visit(valid_operands, opcode))
+    {
+      return error(cit, "operand out of range");
+    }
+
+    if (not std::visit(defined, opcode))
+    {
+      return error(cit, "global variable may be undefined");
+    }
+
+    const auto [pops, pushes] = stack_effects[*cit];
+    if (pops > depth)
+    {
+      return error(cit, "stack underflow");
+    }
+    depth = depth - pops + pushes;
+    max_depth = std::max(max_depth, depth);
+
+    if (*cit == opcode_v<OpReturn>)
+    {
+      if (Code::next(cit) != code.cend())
+      {
+        return error(cit, "unreachable code after OP_RETURN");
+      }
+      if (depth != 0)
+      {
+        return error(cit, fmt::format("{} value(s) left on the stack", depth));
+      }
+
+      chunk.code->set_max_stack_depth(max_depth);
+      return chunk;
+    }
+  }
+
+  return error(code.cend(), "missing OP_RETURN");
+}
+
+// ---------------------------------------------------------------------------------------------- //
+
+} // namespace clox
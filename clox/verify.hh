@@ -0,0 +1,25 @@
+#pragma once
+
+#include <boost/leaf.hpp>
+
+#include "clox/chunk.hh"
+
+namespace clox {
+
+// ---------------------------------------------------------------------------------------------- //
+
+using VerifyResult = boost::leaf::result<Chunk>;
+
+// Check that the code of a chunk can be safely executed by the VM:
+//   - all instructions are valid and complete;
+//   - constants and global variables referenced by instructions exist;
+//   - no instruction pops from an empty stack;
+//   - the code ends with OP_RETURN, with an empty stack.
+// Also record in the code the maximal depth that the stack can reach. On error, the error is
+// reported the same way as compilation errors.
+[[nodiscard]] VerifyResult
+verify(Chunk);
+
+// ---------------------------------------------------------------------------------------------- //
+
+} // namespace clox
@@ -1,42 +1,265 @@
+#include <algorithm>
+#include <array>
+#include <cstdint>
 #include <iostream>
+#include <stdexcept>
+#include <utility>
 
 #include "clox/detail/interpret.hh"
 #include "clox/detail/stack.hh"
 #include "clox/disassemble.hh"
+#include "clox/output.hh"
+#include "clox/trace.hh"
 #include "clox/vm.hh"
 
+// Computed gotos are a GNU extension, also supported by Clang.
+#if defined(__GNUC__)
+#define CLOX_HAS_COMPUTED_GOTO 1
+#else
+#define CLOX_HAS_COMPUTED_GOTO 0
+#endif
+
+// Guaranteed tail calls, without which the tail-call interpreter would overflow the native stack.
+#if defined(__has_cpp_attribute)
+#if __has_cpp_attribute(clang::musttail)
+#define CLOX_HAS_MUSTTAIL 1
+#endif
+#endif
+#ifndef CLOX_HAS_MUSTTAIL
+#define CLOX_HAS_MUSTTAIL 0
+#endif
+
 namespace clox {
 namespace /* anonymous */ {
 
-constexpr auto globals_reserve = 1024;
+// ---------------------------------------------------------------------------------------------- //
+
+// How executed instructions are traced.
+enum class Trace
+{
+  none,
+  // Disassembled to the output of the VM, as they are executed.
+  disassemble,
+  // Recorded to the tracer of the VM, to be decoded later.
+  binary
+};
+
+// Inlined, as it runs before each instruction.
+template<Trace Mode>
+[[gnu::always_inline]] inline void
+trace([[maybe_unused]] Code::const_iterator current_ip,
+      [[maybe_unused]] const detail::Dispatch& dispatch)
+{
+  if constexpr (Mode == Trace::disassemble)
+  {
+    dispatch.output.write_line(disassemble(current_ip, dispatch.chunk));
+  }
+  else if constexpr (Mode == Trace::binary)
+  {
+    // The depth is saturated to fit in the event.
+    constexpr auto max_depth = std::size_t{0xFF'FFFF};
+    dispatch.vm.tracer()->record(
+      {static_cast<std::uint32_t>(std::distance(dispatch.code_begin, current_ip)),
+       static_cast<std::uint32_t>(std::min(dispatch.stack.size(), max_depth)),
+       *current_ip});
+  }
+}
+
+// Execute the instruction of type `Op` starting at `current_ip` and move to the next instruction.
+// If the execution must stop, return false and leave `current_ip` on the current instruction.
+template<typename Op>
+[[nodiscard]] bool
+execute(const detail::Dispatch& dispatch, Code::const_iterator& current_ip)
+{
+  if (not dispatch(Code::operands<Op>(current_ip))) [[unlikely]]
+  {
+    return false;
+  }
+  current_ip = std::next(current_ip, instruction_size_v<Op>);
+  return true;
+}
+
+// ---------------------------------------------------------------------------------------------- //
+
+template<Trace Mode>
+void
+run_switch_loop(const detail::Dispatch& dispatch, Code::const_iterator& current_ip)
+{
+  while (true)
+  {
+    trace<Mode>(current_ip, dispatch);
+
+    switch (*current_ip)
+    {
+      // NOLINTBEGIN(cppcoreguidelines-macro-usage)
+#define CLOX_CASE(name, type)                                                                      \
+  case opcode_v<type>:                                                                             \
+    if (not execute<type>(dispatch, current_ip))                                                   \
+    {                                                                                              \
+      return;                                                                                      \
+    }                                                                                              \
+    break;
+
+      CLOX_OPCODES(CLOX_CASE)
+
+#undef CLOX_CASE
+      // NOLINTEND(cppcoreguidelines-macro-usage)
+
+      default:
+        __builtin_unreachable();
+    }
+  }
+}
+
+// ---------------------------------------------------------------------------------------------- //
+
+#if CLOX_HAS_COMPUTED_GOTO
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+
+template<Trace Mode>
+void
+run_computed_goto(const detail::Dispatch& dispatch, Code::const_iterator& current_ip)
+{
+  // NOLINTBEGIN(cppcoreguidelines-macro-usage,cppcoreguidelines-avoid-goto,hicpp-avoid-goto)
+#define CLOX_LABEL_ADDRESS(name, type) &&op_##name,
+  static constexpr auto labels = std::to_array<void*>({CLOX_OPCODES(CLOX_LABEL_ADDRESS)});
+#undef CLOX_LABEL_ADDRESS
+
+#define CLOX_NEXT()                                                                                \
+  trace<Mode>(current_ip, dispatch);                                                               \
+  goto* labels[*current_ip]
+
+  CLOX_NEXT();
+
+#define CLOX_LABEL(name, type)                                                                     \
+  op_##name : if (not execute<type>(dispatch, current_ip))                                         \
+  {                                                                                                \
+    return;                                                                                        \
+  }                                                                                                \
+  CLOX_NEXT();
+
+  CLOX_OPCODES(CLOX_LABEL)
+
+#undef CLOX_LABEL
+#undef CLOX_NEXT
+  // NOLINTEND(cppcoreguidelines-macro-usage,cppcoreguidelines-avoid-goto,hicpp-avoid-goto)
+}
+
+#pragma GCC diagnostic pop
+
+#endif // CLOX_HAS_COMPUTED_GOTO
+
+// ---------------------------------------------------------------------------------------------- //
+
+#if CLOX_HAS_MUSTTAIL
+
+using Handler = void (*)(const detail::Dispatch&, Code::const_iterator&, Code::const_iterator);
+
+template<Trace Mode>
+const std::array<Handler, std::variant_size_v<Opcode>>& handlers() noexcept;
+
+// When the execution stops, `current_ip` is written back to `last_ip`, as the caller needs it to
+// report runtime errors.
+template<Trace Mode, typename Op>
+void
+handle(const detail::Dispatch& dispatch,
+       Code::const_iterator& last_ip,
+       Code::const_iterator current_ip)
+{
+  if (not execute<Op>(dispatch, current_ip)) [[unlikely]]
+  {
+    last_ip = current_ip;
+    return;
+  }
+  trace<Mode>(current_ip, dispatch);
+  [[clang::musttail]] return handlers<Mode>()[*current_ip](dispatch, last_ip, current_ip);
+}
+
+template<Trace Mode, std::size_t... Is>
+constexpr auto
+make_handlers(std::index_sequence<Is...>)
+{
+  return std::array<Handler, sizeof...(Is)>{
+    &handle<Mode, std::variant_alternative_t<Is, Opcode>>...};
+}
+
+template<Trace Mode>
+const std::array<Handler, std::variant_size_v<Opcode>>&
+handlers() noexcept
+{
+  static constexpr auto table =
+    make_handlers<Mode>(std::make_index_sequence<std::variant_size_v<Opcode>>{});
+  return table;
+}
+
+template<Trace Mode>
+void
+run_tail_call(const detail::Dispatch& dispatch, Code::const_iterator& current_ip)
+{
+  trace<Mode>(current_ip, dispatch);
+  handlers<Mode>()[*current_ip](dispatch, current_ip, current_ip);
+}
+
+#endif // CLOX_HAS_MUSTTAIL
 
 // ---------------------------------------------------------------------------------------------- //
 
-template<VM::opt_disassemble Disassemble>
+template<VM::opt_dispatch Strategy, Trace Mode>
 [[nodiscard]] VMResult
 run(Chunk& chunk, VM& vm)
 {
   auto current_ip = chunk.code->cbegin();
-  auto stack = detail::Stack{};
+  // The chunk has been verified, so the stack will never grow beyond this depth.
+  auto stack = detail::Stack{chunk.code->max_stack_depth()};
+  auto status = detail::Status{};
+  const auto dispatch =
+    detail::Dispatch{chunk, vm, stack, vm.output(), status, chunk.code->cbegin()};
 
-  try
+  if constexpr (Strategy == VM::opt_dispatch::switch_loop)
   {
-    while (true)
-    {
-      if constexpr (Disassemble == VM::opt_disassemble::yes)
-      {
-        std::cout << disassemble(current_ip, chunk) << '\n';
-      }
-      current_ip = detail::Interpret{chunk, vm, stack, std::cout, current_ip}.visit();
-    }
+    run_switch_loop<Mode>(dispatch, current_ip);
   }
-  catch (const detail::InterpretReturn& r)
+#if CLOX_HAS_COMPUTED_GOTO
+  else if constexpr (Strategy == VM::opt_dispatch::computed_goto)
   {
-    if (r.status != VMResultStatus::ok)
-    {
-      std::cerr << "line " << chunk.code->line(current_ip).value_or(0) << ": " << r.message << '\n';
-    }
-    return {r.status, std::move(chunk.memory)};
+    run_computed_goto<Mode>(dispatch, current_ip);
+  }
+#endif
+#if CLOX_HAS_MUSTTAIL
+  else if constexpr (Strategy == VM::opt_dispatch::tail_call)
+  {
+    run_tail_call<Mode>(dispatch, current_ip);
+  }
+#endif
+
+  // Before errors, which are not buffered.
+  vm.output().flush();
+  if (status.status != VMResultStatus::ok)
+  {
+    const auto [line, column] = chunk.code->location(current_ip).value_or(SourceLocation{0, 0});
+    std::cerr << "line " << line << ", column " << column << ": " << status.message << '\n';
+  }
+  return {status.status, std::move(chunk.memory)};
+}
+
+template<VM::opt_dispatch Strategy>
+[[nodiscard]] VMResult
+run(Chunk& chunk, VM& vm, VM::opt_disassemble disassemble)
+{
+  if (vm.tracer() != nullptr)
+  {
+    vm.tracer()->start(*chunk.code);
+    return run<Strategy, Trace::binary>(chunk, vm);
+  }
+  else if (disassemble == VM::opt_disassemble::yes)
+  {
+    return run<Strategy, Trace::disassemble>(chunk, vm);
+  }
+  else
+  {
+    return run<Strategy, Trace::none>(chunk, vm);
   }
 }
 
@@ -44,10 +267,37 @@ run(Chunk& chunk, VM& vm)
 
 // ---------------------------------------------------------------------------------------------- //
 
-VM::VM(VM::opt_disassemble disassemble)
+bool
+VM::supports(VM::opt_dispatch dispatch) noexcept
+{
+  switch (dispatch)
+  {
+    case opt_dispatch::switch_loop:
+      return true;
+    case opt_dispatch::computed_goto:
+      return CLOX_HAS_COMPUTED_GOTO;
+    case opt_dispatch::tail_call:
+      return CLOX_HAS_MUSTTAIL;
+  }
+  return false;
+}
+
+static_assert(VM::default_dispatch != VM::opt_dispatch::computed_goto or CLOX_HAS_COMPUTED_GOTO,
+              "Computed gotos are not supported by this compiler");
+static_assert(VM::default_dispatch != VM::opt_dispatch::tail_call or CLOX_HAS_MUSTTAIL,
+              "Guaranteed tail calls are not supported by this compiler");
+
+// ---------------------------------------------------------------------------------------------- //
+
+VM::VM(VM::opt_disassemble disassemble, VM::opt_dispatch dispatch)
   : disassemble_{disassemble}
+  , dispatch_{dispatch}
+  , output_{&standard_output()}
 {
-  globals_.reserve(globals_reserve);
+  if (not supports(dispatch))
+  {
+    throw std::invalid_argument{"Unsupported dispatch strategy"};
+  }
 }
 
 // ---------------------------------------------------------------------------------------------- //
@@ -55,13 +305,21 @@ VM::VM(VM::opt_disassemble disassemble)
 VMResult
 VM::operator()(Chunk&& chunk)
 {
-  if (disassemble_ == opt_disassemble::yes)
-  {
-    return run<opt_disassemble::yes>(chunk, *this);
-  }
-  else
+  // Variables may have been added to Memory by the compilation of this chunk.
+  globals_.resize(chunk.memory->nb_global_variables());
+
+  switch (dispatch_)
   {
-    return run<opt_disassemble::no>(chunk, *this);
+#if CLOX_HAS_COMPUTED_GOTO
+    case opt_dispatch::computed_goto:
+      return run<opt_dispatch::computed_goto>(chunk, *this, disassemble_);
+#endif
+#if CLOX_HAS_MUSTTAIL
+    case opt_dispatch::tail_call:
+      return run<opt_dispatch::tail_call>(chunk, *this, disassemble_);
+#endif
+    default:
+      return run<opt_dispatch::switch_loop>(chunk, *this, disassemble_);
   }
 }
 
@@ -1,13 +1,19 @@
 #pragma once
 
 #include <memory>
-#include <unordered_map>
 
 #include "clox/chunk.hh"
-#include "clox/detail/index.hh"
+#include "clox/detail/globals.hh"
+
+#ifndef CLOX_DISPATCH
+#define CLOX_DISPATCH switch_loop
+#endif
 
 namespace clox {
 
+class Output;
+class Tracer;
+
 // ---------------------------------------------------------------------------------------------- //
 
 enum class VMResultStatus
@@ -35,15 +41,49 @@ public:
     no
   };
 
-  explicit VM(opt_disassemble disassemble = opt_disassemble::no);
+  enum class opt_dispatch
+  {
+    // A loop around a switch on the current opcode.
+    switch_loop,
+    // Each instruction jumps directly to the code of the next one (GCC and Clang only).
+    computed_goto,
+    // Each instruction is a function which tail-calls the next one (Clang only).
+    tail_call
+  };
+
+  // Strategy selected with the CLOX_DISPATCH CMake option.
+  static constexpr auto default_dispatch = opt_dispatch::CLOX_DISPATCH;
+
+  [[nodiscard]] static bool supports(opt_dispatch) noexcept;
 
+  explicit VM(opt_disassemble disassemble = opt_disassemble::no,
+              opt_dispatch dispatch = default_dispatch);
+
+  // The memory of the chunk must not be used by another VM at the same time, as collections only
+  // keep alive the values reachable from this one.
   [[nodiscard]] VMResult operator()(Chunk&&);
 
+  // Record executed instructions to `tracer` rather than disassembling them to the output, or stop
+  // tracing if it's null. The tracer must outlive the runs of this VM, which must all run the same
+  // chunk.
+  void set_tracer(Tracer* tracer) noexcept { tracer_ = tracer; }
+
+  [[nodiscard]] Tracer* tracer() const noexcept { return tracer_; }
+
+  // Print values and disassembled instructions to `output` rather than to standard_output(). The
+  // output must outlive the runs of this VM, and is flushed at the end of each of them.
+  void set_output(Output& output) noexcept { output_ = &output; }
+
+  [[nodiscard]] Output& output() const noexcept { return *output_; }
+
   [[nodiscard]] auto& globals() noexcept { return globals_; }
 
 private:
   opt_disassemble disassemble_{opt_disassemble::no};
-  std::unordered_map<detail::GlobalVariableIndex, Value> globals_{};
+  opt_dispatch dispatch_{default_dispatch};
+  Tracer* tracer_{nullptr};
+  Output* output_;
+  detail::Globals globals_{};
 };
 
 // ---------------------------------------------------------------------------------------------- //
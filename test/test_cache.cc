@@ -0,0 +1,90 @@
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <unistd.h>
+
+#include <catch2/catch_test_macros.hpp>
+#include <fmt/core.h>
+
+#include "clox/cache.hh"
+#include "clox/compile.hh"
+#include "clox/vm.hh"
+
+using namespace clox;
+
+// NOLINTBEGIN(readability-magic-numbers)
+
+TEST_CASE("Bytecode cache", "[cache]")
+{
+  static constexpr auto program = R"(var greeting = "hello";
+var n = 1;
+n = n + 2.5;
+print greeting + " world";
+print n == 3.5;
+print nil;)";
+
+  const auto path =
+    std::filesystem::temp_directory_path() / fmt::format("clox_test_cache_{}.cloxc", ::getpid());
+  auto compiled = Compile{Scanner{program}}(std::make_shared<Memory>());
+  REQUIRE(static_cast<bool>(compiled));
+  const auto& chunk = compiled.value();
+  const auto key = cache_key(program);
+  save_cache(path, chunk, key);
+
+  SECTION("Round trip")
+  {
+    const auto loaded = load_cache(path, key);
+    REQUIRE(loaded.has_value());
+
+    const auto& code = *loaded->code;
+    REQUIRE(std::ranges::equal(code.bytecode(), chunk.code->bytecode()));
+    REQUIRE(code.nb_source_offset_runs() == chunk.code->nb_source_offset_runs());
+    REQUIRE(code.instructions().back().source_offset ==
+            chunk.code->instructions().back().source_offset);
+    REQUIRE(code.max_stack_depth() == chunk.code->max_stack_depth());
+    REQUIRE(loaded->memory->global_variable_names() == chunk.memory->global_variable_names());
+
+    // Strings are interned in the new memory.
+    REQUIRE(code.nb_constants() == chunk.code->nb_constants());
+    for (auto i = std::uint32_t{0}; i < code.nb_constants(); ++i)
+    {
+      const auto index = detail::ConstantIndex{i};
+      const auto constant = code.get_constant(index);
+      REQUIRE(fmt::format("{}", constant) == fmt::format("{}", chunk.code->get_constant(index)));
+      if (constant.is<const ObjString*>())
+      {
+        const auto* str = constant.unchecked_as<const ObjString*>();
+        REQUIRE(loaded->memory->make_string(str->str()) == str);
+      }
+    }
+
+    auto vm = VM{};
+    REQUIRE(vm(Chunk{*loaded}).status == VMResultStatus::ok);
+  }
+
+  SECTION("Stale")
+  {
+    REQUIRE_FALSE(load_cache(path, cache_key("print 1;")).has_value());
+    REQUIRE_FALSE(load_cache(path.string() + ".missing", key).has_value());
+  }
+
+  SECTION("Corrupted")
+  {
+    const auto size = std::filesystem::file_size(path);
+    std::filesystem::resize_file(path, size - 1);
+    REQUIRE_FALSE(load_cache(path, key).has_value());
+  }
+
+  std::filesystem::remove(path);
+}
+
+TEST_CASE("Cache path", "[cache]")
+{
+  REQUIRE(cache_path("dir/script.clox") == std::filesystem::path{"dir/script.cloxc"});
+  REQUIRE(cache_path("script") == std::filesystem::path{"script.cloxc"});
+  REQUIRE(cache_path("script.cloxc") == std::filesystem::path{"script.cloxc.cloxc"});
+}
+
+// NOLINTEND(readability-magic-numbers)
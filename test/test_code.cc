@@ -0,0 +1,93 @@
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "clox/code.hh"
+
+using namespace clox;
+
+// NOLINTBEGIN(readability-magic-numbers)
+
+TEST_CASE("Encoding", "[Code]")
+{
+  SECTION("Operand-free opcodes take one byte")
+  {
+    auto code = Code{};
+    code.add_opcode(OpNil{}, 1);
+    code.add_opcode(OpAdd{}, 1);
+    code.add_opcode(OpReturn{}, 2);
+
+    REQUIRE(code.size() == 3);
+    REQUIRE(std::holds_alternative<OpNil>(Code::decode(code.cbegin())));
+    REQUIRE(std::holds_alternative<OpReturn>(Code::decode(std::next(code.cbegin(), 2))));
+    REQUIRE(code.source_offset(std::next(code.cbegin(), 2)) == 2);
+  }
+
+  SECTION("Operands are stored inline")
+  {
+    auto code = Code{};
+    const auto index = code.add_constant(42.0);
+    code.add_opcode(OpConstant{index}, 1);
+    code.add_opcode(OpGetGlobalVar{detail::GlobalVariableIndex{513}}, 2);
+    code.add_opcode(OpPrint{}, 3);
+
+    REQUIRE(code.size() == 7);
+
+    auto it = code.cbegin();
+    const auto constant = std::get<OpConstant>(Code::decode(it));
+    REQUIRE(code.get_constant(constant.constant) == Value{42.0});
+
+    it = Code::next(it);
+    REQUIRE(code.code_offset(it) == 3);
+    REQUIRE(code.source_offset(it) == 2);
+    REQUIRE(static_cast<std::uint16_t>(Code::operands<OpGetGlobalVar>(it).global_variable_index) ==
+            513);
+
+    it = Code::next(it);
+    REQUIRE(std::holds_alternative<OpPrint>(Code::decode(it)));
+    REQUIRE(Code::next(it) == code.cend());
+  }
+}
+
+TEST_CASE("Source offsets", "[Code]")
+{
+  auto code = Code{};
+  code.add_opcode(OpNil{}, 1);
+  code.add_opcode(OpConstant{code.add_constant(1.0)}, 1);
+  code.add_opcode(OpPrint{}, 1);
+  code.add_opcode(OpNil{}, 6);
+  code.add_opcode(OpPop<1>{});
+  code.add_opcode(OpReturn{}, 6);
+
+  // Consecutive instructions from the same token share an entry.
+  REQUIRE(code.nb_source_offset_runs() == 4);
+
+  const auto offsets = std::vector<std::optional<std::size_t>>{1, 1, 1, 1, 1, 6, std::nullopt, 6};
+  for (auto it = code.cbegin(); it != code.cend(); ++it)
+  {
+    REQUIRE(code.source_offset(it) == offsets[code.code_offset(it)]);
+  }
+
+  SECTION("Locations need an index of the lines of the source")
+  {
+    const auto last = std::prev(code.cend());
+    REQUIRE_FALSE(code.location(last).has_value());
+    code.set_line_index(std::make_shared<LineIndex>("a\nbc\nd"));
+    REQUIRE(code.location(last) == SourceLocation{3, 2});
+    REQUIRE(code.location(code.cbegin()) == SourceLocation{1, 2});
+    REQUIRE_FALSE(code.location(std::next(code.cbegin(), 6)).has_value());
+  }
+
+  SECTION("Truncation drops the offsets of removed instructions")
+  {
+    code.truncate(4, 1);
+    REQUIRE(code.nb_source_offset_runs() == 1);
+    code.add_opcode(OpReturn{}, 3);
+    REQUIRE(code.source_offset(std::next(code.cbegin(), 3)) == 1);
+    REQUIRE(code.source_offset(std::next(code.cbegin(), 4)) == 3);
+  }
+}
+
+// NOLINTEND(readability-magic-numbers)
@@ -0,0 +1,148 @@
+#include <algorithm>
+#include <string>
+
+#include <catch2/catch_test_macros.hpp>
+#include <fmt/core.h>
+
+#include "clox/compile.hh"
+#include "clox/detail/visitor.hh"
+
+using namespace clox;
+
+// NOLINTBEGIN(readability-magic-numbers)
+
+namespace /* anonymous */ {
+
+std::vector<Instruction>
+compile(const std::string& program)
+{
+  auto result = Compile{Scanner{program}}(std::make_shared<Memory>());
+  REQUIRE(static_cast<bool>(result));
+  return result.value().code->instructions();
+}
+
+Value
+printed_constant(const std::string& program)
+{
+  auto result = Compile{Scanner{program}}(std::make_shared<Memory>());
+  REQUIRE(static_cast<bool>(result));
+  const auto& code = *result.value().code;
+  const auto instructions = code.instructions();
+  // The program ends with the print of the constant.
+  REQUIRE(instructions.size() >= 3);
+  const auto print = std::prev(instructions.cend(), 2);
+  REQUIRE(std::holds_alternative<OpPrint>(print->opcode));
+  return std::visit(
+    detail::visitor{[&](OpConstant op) { return code.get_constant(op.constant); },
+                    [](OpTrue) { return Value{true}; },
+                    [](OpFalse) { return Value{false}; },
+                    [](OpNil) { return Value{Nil{}}; },
+                    [](const auto&) -> Value { FAIL("Not a constant"); return {}; }},
+    std::prev(print)->opcode);
+}
+
+} // namespace
+
+TEST_CASE("Constant folding", "[compile]")
+{
+  REQUIRE(printed_constant("print 3 + 2 * (1 + 2);") == Value{9.0});
+  REQUIRE(printed_constant("print -(1 - 3);") == Value{2.0});
+  REQUIRE(printed_constant("print 1 <= 2;") == Value{true});
+  REQUIRE(printed_constant("print !nil;") == Value{false});
+  REQUIRE(printed_constant(R"(print "a" + "b" == "ab";)") == Value{true});
+  REQUIRE(printed_constant("var a = 2; var b = a * 3; print b + a;") == Value{8.0});
+}
+
+TEST_CASE("Numbers", "[compile]")
+{
+  REQUIRE(printed_constant("print 12.5;") == Value{12.5});
+  REQUIRE(printed_constant("print 0.1;") == Value{0.1});
+
+  SECTION("Numbers which don't fit in a double are errors")
+  {
+    const auto program = fmt::format("print 1{};", std::string(400, '0'));
+    auto result = Compile{Scanner{program}}(std::make_shared<Memory>());
+    REQUIRE_FALSE(static_cast<bool>(result));
+  }
+}
+
+TEST_CASE("Expressions which can't be folded", "[compile]")
+{
+  SECTION("Runtime errors")
+  {
+    const auto instructions = compile(R"(print -"a";)");
+    REQUIRE(std::holds_alternative<OpNegate>(instructions[1].opcode));
+  }
+
+  SECTION("Assigned global variable")
+  {
+    const auto instructions = compile("var a = 1; a = 2; print a;");
+    REQUIRE(not std::holds_alternative<OpConstant>(instructions[5].opcode));
+  }
+
+  SECTION("Global variable used before its definition")
+  {
+    const auto instructions = compile("print a; var a = 1;");
+    REQUIRE(std::holds_alternative<OpGetGlobalVar>(instructions[0].opcode));
+  }
+}
+
+TEST_CASE("Definitely defined global variables", "[compile]")
+{
+  const auto instructions = compile("var a = 1; a = 2; print a;");
+  REQUIRE(std::holds_alternative<OpSetGlobalUnchecked>(instructions[3].opcode));
+  REQUIRE(std::holds_alternative<OpGetGlobalVarUnchecked>(instructions[5].opcode));
+}
+
+TEST_CASE("Constant pool", "[compile]")
+{
+  SECTION("Constants are deduplicated")
+  {
+    auto result = Compile{Scanner{R"(var a; a = 1; a = "x"; a = 1; a = "x"; a = 0; a = -0;)"}}(
+      std::make_shared<Memory>());
+    REQUIRE(static_cast<bool>(result));
+    // 1, "x", 0 and -0.
+    REQUIRE(result.value().code->nb_constants() == 4);
+  }
+
+  SECTION("Folded constants are forgotten")
+  {
+    auto result =
+      Compile{Scanner{"var a; a = 1 + 2; a = 1; a = 2;"}}(std::make_shared<Memory>());
+    REQUIRE(static_cast<bool>(result));
+    // 3, 1 and 2.
+    REQUIRE(result.value().code->nb_constants() == 3);
+  }
+
+  SECTION("Large programs use the long forms of instructions")
+  {
+    constexpr auto nb_variables = 70'000;
+
+    auto program = std::string{};
+    for (auto i = 0; i < nb_variables; ++i)
+    {
+      program += fmt::format("var v{} = \"{}\"; v{} = v{} + \"\";\n", i, i, i, i);
+    }
+    program += fmt::format("print v{};", nb_variables - 1);
+
+    auto result = Compile{Scanner{program}}(std::make_shared<Memory>());
+    REQUIRE(static_cast<bool>(result));
+    const auto& code = *result.value().code;
+    REQUIRE(code.nb_constants() == nb_variables + 1);
+
+    const auto instructions = code.instructions();
+    const auto has = [&]<typename Op>(Op)
+    {
+      return std::ranges::any_of(instructions,
+                                 [](const auto& instruction)
+                                 { return std::holds_alternative<Op>(instruction.opcode); });
+    };
+    REQUIRE(has(OpConstant{detail::ConstantIndex{0}}));
+    REQUIRE(has(OpConstantLong{detail::ConstantIndex{0}}));
+    REQUIRE(has(OpDefineGlobalVarLong{detail::GlobalVariableIndex{0}}));
+    REQUIRE(has(OpSetGlobalUncheckedLong{detail::GlobalVariableIndex{0}}));
+    REQUIRE(has(OpGetGlobalVarUncheckedLong{detail::GlobalVariableIndex{0}}));
+  }
+}
+
+// NOLINTEND(readability-magic-numbers)
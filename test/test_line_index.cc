@@ -0,0 +1,73 @@
+#include <algorithm>
+#include <cstddef>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "clox/line_index.hh"
+#include "clox/scanner.hh"
+
+using namespace clox;
+
+// NOLINTBEGIN(readability-magic-numbers)
+
+namespace /* anonymous */ {
+
+constexpr auto source = std::string_view{"var a = 1;\n\nprint \"two\nlines\";\n  a"};
+
+} // namespace
+
+TEST_CASE("Locations", "[line_index]")
+{
+  const auto expected = std::vector<std::pair<std::size_t, SourceLocation>>{
+    {0, {1, 1}}, {9, {1, 10}}, {10, {1, 11}}, {11, {2, 1}}, {12, {3, 1}}, {18, {3, 7}},
+    {23, {4, 1}}, {30, {4, 8}}, {31, {5, 1}}, {33, {5, 3}}, {34, {5, 4}}};
+
+  SECTION("Source in memory")
+  {
+    const auto index = LineIndex{source};
+    for (const auto& [offset, location] : expected)
+    {
+      REQUIRE(index.location(offset) == location);
+    }
+    REQUIRE(index.nb_lines() == 5);
+  }
+
+  SECTION("Streamed source")
+  {
+    auto index = LineIndex{};
+    for (auto rest = source; not rest.empty();)
+    {
+      const auto size = std::min(rest.size(), std::size_t{4});
+      index.add(rest.substr(0, size));
+      rest.remove_prefix(size);
+    }
+    for (const auto& [offset, location] : expected)
+    {
+      REQUIRE(index.location(offset) == location);
+    }
+  }
+}
+
+TEST_CASE("Locations of tokens", "[line_index]")
+{
+  auto scanner = Scanner{source};
+  const auto index = scanner.line_index();
+  const auto next = [&] { return index->location(scanner.next_token().offset); };
+
+  REQUIRE(next() == SourceLocation{1, 1});
+  REQUIRE(next() == SourceLocation{1, 5});
+  REQUIRE(next() == SourceLocation{1, 7});
+  REQUIRE(next() == SourceLocation{1, 9});
+  REQUIRE(next() == SourceLocation{1, 10});
+  REQUIRE(next() == SourceLocation{3, 1});
+  // A string is located at its opening quote.
+  REQUIRE(next() == SourceLocation{3, 7});
+  REQUIRE(next() == SourceLocation{4, 7});
+  REQUIRE(next() == SourceLocation{5, 3});
+  REQUIRE(next() == SourceLocation{5, 4});
+}
+
+// NOLINTEND(readability-magic-numbers)
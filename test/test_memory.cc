@@ -0,0 +1,248 @@
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "clox/arena.hh"
+#include "clox/code.hh"
+#include "clox/compile.hh"
+#include "clox/detail/hash.hh"
+#include "clox/memory.hh"
+#include "clox/scanner.hh"
+#include "clox/vm.hh"
+
+using namespace clox;
+
+// NOLINTBEGIN(readability-magic-numbers)
+
+TEST_CASE("Hash", "[Memory]")
+{
+  REQUIRE(detail::hash("abc") == detail::hash(std::string{"abc"}));
+  REQUIRE(detail::hash("abc") != detail::hash("abd"));
+  REQUIRE(detail::hash("") != detail::hash(std::string_view{"\0", 1}));
+
+  const auto long_string = std::string(100, 'x');
+  REQUIRE(detail::hash(long_string) != detail::hash(long_string.substr(1)));
+}
+
+TEST_CASE("Arena", "[Memory]")
+{
+  auto arena = Arena{};
+
+  SECTION("Small allocations share blocks")
+  {
+    auto* a = arena.allocate(3, 1);
+    auto* b = arena.allocate(8, 8);
+    REQUIRE(reinterpret_cast<std::uintptr_t>(b) % 8 == 0);
+    REQUIRE(static_cast<std::byte*>(b) - static_cast<std::byte*>(a) == 8);
+    REQUIRE(arena.stats().nb_blocks == 1);
+    // Sizes are rounded up to the alignment of pointers.
+    REQUIRE(arena.stats().allocated == 16);
+  }
+
+  SECTION("Large allocations get their own block")
+  {
+    [[maybe_unused]] auto* a = arena.allocate(1, 1);
+    [[maybe_unused]] auto* b = arena.allocate(1'000'000, 8);
+    [[maybe_unused]] auto* c = arena.allocate(1, 1);
+    REQUIRE(arena.stats().nb_blocks == 2);
+    REQUIRE(static_cast<std::byte*>(c) - static_cast<std::byte*>(a) == 8);
+
+    arena.deallocate(b, 1'000'000);
+    REQUIRE(arena.stats().nb_blocks == 1);
+  }
+
+  SECTION("Freed storage is reused by allocations of the same size")
+  {
+    auto* a = arena.allocate(20, 8);
+    [[maybe_unused]] auto* b = arena.allocate(20, 8);
+    arena.deallocate(a, 20);
+    REQUIRE(arena.stats().allocated == 24);
+    REQUIRE(arena.allocate(24, 4) == a);
+    REQUIRE(arena.allocate(24, 4) != a);
+  }
+
+  SECTION("Objects don't move with the arena")
+  {
+    auto* obj = ObjString::make(arena, "abc", detail::hash("abc"));
+    const auto moved = std::move(arena);
+    REQUIRE(obj->str() == "abc");
+    REQUIRE(moved.stats().nb_blocks == 1);
+  }
+}
+
+TEST_CASE("Interned strings", "[Memory]")
+{
+  auto memory = Memory{};
+
+  SECTION("Equal strings are the same object")
+  {
+    const auto* a = memory.make_string("a");
+    REQUIRE(memory.make_string("a") == a);
+    REQUIRE(memory.make_string("b") != a);
+  }
+
+  SECTION("The table grows")
+  {
+    constexpr auto nb_strings = 100'000;
+
+    auto strings = std::vector<const ObjString*>{};
+    for (auto i = 0; i < nb_strings; ++i)
+    {
+      strings.push_back(memory.make_string(std::to_string(i)));
+
+      if (i % 1'000 == 0)
+      {
+        const auto stats = memory.interned_strings_stats();
+        REQUIRE(stats.nb_strings == strings.size());
+        REQUIRE(stats.load_factor <= 1.0);
+      }
+    }
+
+    // All strings are still found, whether they have been moved to the new buckets or not.
+    for (auto i = 0; i < nb_strings; i += 7)
+    {
+      REQUIRE(memory.make_string(std::to_string(i)) == strings[i]);
+    }
+    REQUIRE(memory.interned_strings_stats().nb_strings == nb_strings);
+    REQUIRE(memory.interned_strings_stats().max_chain_length < 16);
+  }
+}
+
+TEST_CASE("Concatenations", "[Memory]")
+{
+  auto memory = Memory{};
+
+  SECTION("Short strings are flattened")
+  {
+    const auto value = memory.concatenate(memory.make_string("a"), memory.make_string("b"));
+    REQUIRE(value.is<const ObjString*>());
+    REQUIRE(value.as<const ObjString*>() == memory.make_string("ab"));
+  }
+
+  SECTION("Long strings are ropes")
+  {
+    const auto line = memory.make_string(std::string(10, 'x') + '\n');
+
+    auto expected = std::string{};
+    auto value = Value{memory.make_string("")};
+    for (auto i = 0; i < 10'000; ++i)
+    {
+      value = memory.concatenate(value, line);
+      expected += line->str();
+    }
+    REQUIRE(value.is<const ObjRope*>());
+    REQUIRE(value.is_string());
+    REQUIRE(value.type() == "string");
+    REQUIRE(value.as<const ObjRope*>()->length == expected.size());
+
+    auto os = std::ostringstream{};
+    os << value;
+    REQUIRE(os.str() == expected);
+
+    // Ropes are equal to strings with the same content, and are interned on demand.
+    const auto interned = memory.intern(value);
+    REQUIRE(interned.is<const ObjString*>());
+    REQUIRE(interned.as<const ObjString*>()->str() == expected);
+    REQUIRE(interned == Value{memory.make_string(expected)});
+    REQUIRE(value == interned);
+    REQUIRE(memory.intern(value) == interned);
+    REQUIRE(Value{memory.make_string("y")} > value);
+
+    // A flattened rope is not walked again when concatenated.
+    const auto longer = memory.concatenate(value, line);
+    REQUIRE(std::get<const ObjString*>(longer.as<const ObjRope*>()->lhs) ==
+            interned.as<const ObjString*>());
+  }
+}
+
+TEST_CASE("Garbage collection", "[Memory]")
+{
+  auto memory = Memory{};
+
+  const auto kept = Value{memory.make_string("kept")};
+  const auto* dropped = memory.make_string("dropped");
+  const auto long_string = Value{memory.make_string(std::string(100, 'x'))};
+  const auto rope = memory.concatenate(memory.concatenate(long_string, memory.make_string("a")),
+                                       memory.make_string("b"));
+  const auto flattened = memory.intern(rope);
+  const auto heap_size = memory.heap_size();
+
+  SECTION("Unreachable objects are freed")
+  {
+    const auto roots = std::vector<Value>{kept, rope};
+    memory.collect({roots});
+
+    REQUIRE(memory.gc_stats().nb_collections == 1);
+    REQUIRE(memory.gc_stats().nb_freed_objects == 1);
+    REQUIRE(memory.heap_size() < heap_size);
+    // "kept", the parts of the ropes and the flattened string.
+    REQUIRE(memory.interned_strings_stats().nb_strings == 5);
+
+    // Parts of reachable ropes and their flattened string are kept.
+    std::ostringstream os;
+    os << rope;
+    REQUIRE(os.str() == std::string(100, 'x') + "ab");
+    REQUIRE(memory.intern(rope) == flattened);
+    REQUIRE(memory.make_string("kept") == kept.as<const ObjString*>());
+
+    // Interned strings are weak: an equal string created later is a new object.
+    REQUIRE(memory.make_string("dropped")->str() == "dropped");
+  }
+
+  SECTION("Constants of live code are roots")
+  {
+    auto code = std::make_shared<Code>();
+    [[maybe_unused]] const auto index = code->add_constant(dropped);
+    memory.add_code(code);
+
+    memory.collect({});
+    REQUIRE(memory.make_string("dropped") == dropped);
+
+    code.reset();
+    memory.collect({});
+    REQUIRE(memory.interned_strings_stats().nb_strings == 0);
+  }
+
+  SECTION("Heap growth triggers collections")
+  {
+    auto small_memory = Memory{GcConfig{.min_heap_size = 1024, .growth_factor = 2.0}};
+    REQUIRE(not small_memory.should_collect());
+    for (auto i = 0; not small_memory.should_collect(); ++i)
+    {
+      [[maybe_unused]] const auto* str = small_memory.make_string(std::to_string(i));
+    }
+    small_memory.collect({});
+    REQUIRE(small_memory.heap_size() == 0);
+    REQUIRE(not small_memory.should_collect());
+  }
+}
+
+TEST_CASE("Garbage collection while running", "[Memory]")
+{
+  // Collect at every opportunity.
+  auto memory = std::make_shared<Memory>(GcConfig{.min_heap_size = 0, .growth_factor = 0.0});
+
+  auto program = std::string{"var s = \"\"; var t = \"\";\n"};
+  for (auto i = 0; i < 100; ++i)
+  {
+    program += "s = s + \"a line which is long enough to build a rope\";\n";
+    program += "t = t + \"x\" + \"y\";\n";
+  }
+  program += "var same = s == s + \"\";\n";
+
+  auto chunk = Compile{Scanner{program}}(memory);
+  REQUIRE(chunk);
+  auto vm = VM{};
+  const auto result = vm(std::move(chunk.value()));
+
+  REQUIRE(result.status == VMResultStatus::ok);
+  REQUIRE(memory->gc_stats().nb_collections > 0);
+  REQUIRE(memory->gc_stats().nb_freed_objects > 0);
+}
+
+// NOLINTEND(readability-magic-numbers)
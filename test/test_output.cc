@@ -0,0 +1,103 @@
+#include <array>
+#include <memory>
+#include <sstream>
+#include <string>
+
+#include <catch2/catch_test_macros.hpp>
+#include <unistd.h>
+
+#include "clox/compile.hh"
+#include "clox/memory.hh"
+#include "clox/output.hh"
+#include "clox/vm.hh"
+
+using namespace clox;
+
+// NOLINTBEGIN(readability-magic-numbers)
+
+TEST_CASE("Printed values", "[output]")
+{
+  auto memory = Memory{};
+  auto os = std::ostringstream{};
+  {
+    auto output = Output{os};
+    output.print(2.0);
+    output.print(0.1 + 0.2);
+    output.print(1e6);
+    output.print(-1.5e300);
+    output.print(true);
+    output.print(Nil{});
+    output.print(memory.make_string("string"));
+    output.print(memory.concatenate(memory.make_string(std::string(40, 'x')),
+                                    memory.make_string("rope")));
+    output.write_line("line");
+  }
+  REQUIRE(os.str() == "2\n0.30000000000000004\n1000000\n-1.5e+300\ntrue\nnil\nstring\n" +
+                        std::string(40, 'x') + "rope\nline\n");
+}
+
+TEST_CASE("Flush policies", "[output]")
+{
+  auto os = std::ostringstream{};
+
+  SECTION("Line")
+  {
+    auto output = Output{os, Output::opt_flush::line};
+    output.print(1.0);
+    REQUIRE(os.str() == "1\n");
+  }
+
+  SECTION("Size")
+  {
+    auto output = Output{os, Output::opt_flush::size, 4};
+    output.print(1.0);
+    REQUIRE(os.str().empty());
+    output.print(2.0);
+    REQUIRE(os.str() == "1\n2\n");
+  }
+
+  SECTION("Exit")
+  {
+    auto output = Output{os, Output::opt_flush::exit, 4};
+    for (auto i = 0; i < 10; ++i)
+    {
+      output.print(1.0);
+    }
+    REQUIRE(os.str().empty());
+    output.flush();
+    REQUIRE(os.str().size() == 20);
+  }
+}
+
+TEST_CASE("File descriptor", "[output]")
+{
+  auto fds = std::array<int, 2>{};
+  REQUIRE(::pipe(fds.data()) == 0);
+  {
+    auto output = Output{fds[1]};
+    output.print(42.0);
+  }
+  ::close(fds[1]);
+
+  auto buffer = std::array<char, 16>{};
+  const auto read = ::read(fds[0], buffer.data(), buffer.size());
+  ::close(fds[0]);
+  REQUIRE(std::string(buffer.data(), static_cast<std::size_t>(read)) == "42\n");
+}
+
+TEST_CASE("Output of the VM", "[output]")
+{
+  auto compiled = Compile{Scanner{R"(var a = 1; print a / 4; print "a" + "b"; print a < 2;)"}}(
+    std::make_shared<Memory>());
+  REQUIRE(static_cast<bool>(compiled));
+
+  auto os = std::ostringstream{};
+  auto output = Output{os, Output::opt_flush::exit};
+  auto vm = VM{VM::opt_disassemble::no};
+  vm.set_output(output);
+  REQUIRE(vm(std::move(compiled.value())).status == VMResultStatus::ok);
+  // Flushed at the end of the run.
+  REQUIRE(os.str() == "0.25\nab\ntrue\n");
+}
+
+// NOLINTEND(readability-magic-numbers)
@@ -0,0 +1,125 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "clox/code.hh"
+#include "clox/peephole.hh"
+#include "clox/profile.hh"
+
+using namespace clox;
+
+// NOLINTBEGIN(readability-magic-numbers)
+
+namespace /* anonymous */ {
+
+template<typename... Ops>
+bool
+has_opcodes(const Code& code)
+{
+  const auto instructions = code.instructions();
+  auto it = instructions.cbegin();
+  return instructions.size() == sizeof...(Ops) and
+         (... and std::holds_alternative<Ops>((it++)->opcode));
+}
+
+} // namespace
+
+TEST_CASE("Superinstructions", "[peephole]")
+{
+  auto code = Code{};
+  const auto index = code.add_constant(1.0);
+
+  SECTION("Negated comparison")
+  {
+    code.add_opcode(OpNil{});
+    code.add_opcode(OpNil{});
+    code.add_opcode(OpLess{});
+    code.add_opcode(OpNot{});
+    code.add_opcode(OpPrint{});
+    code.add_opcode(OpReturn{});
+    peephole(code);
+
+    REQUIRE(has_opcodes<OpNil, OpNil, OpNotLess, OpPrint, OpReturn>(code));
+  }
+
+  SECTION("Double negation")
+  {
+    code.add_opcode(OpNil{});
+    code.add_opcode(OpNil{});
+    code.add_opcode(OpEqual{});
+    code.add_opcode(OpNot{});
+    code.add_opcode(OpNot{});
+    code.add_opcode(OpPrint{});
+    code.add_opcode(OpReturn{});
+    peephole(code);
+
+    REQUIRE(has_opcodes<OpNil, OpNil, OpEqual, OpPrint, OpReturn>(code));
+  }
+
+  SECTION("Constant operand")
+  {
+    code.add_opcode(OpGetGlobalVar{detail::GlobalVariableIndex{0}});
+    code.add_opcode(OpConstant{index});
+    code.add_opcode(OpMultiply{});
+    code.add_opcode(OpPrint{});
+    code.add_opcode(OpReturn{});
+    peephole(code);
+
+    REQUIRE(has_opcodes<OpGetGlobalVar, OpMultiplyConstant, OpPrint, OpReturn>(code));
+    const auto op = std::get<OpMultiplyConstant>(code.instructions()[1].opcode);
+    REQUIRE(detail::to_integer(op.constant) == detail::to_integer(index));
+  }
+
+  SECTION("Global variable operand")
+  {
+    code.add_opcode(OpConstant{index});
+    code.add_opcode(OpGetGlobalVar{detail::GlobalVariableIndex{3}});
+    code.add_opcode(OpSubtract{});
+    code.add_opcode(OpPrint{});
+    code.add_opcode(OpReturn{});
+    peephole(code);
+
+    REQUIRE(has_opcodes<OpConstant, OpSubtractGlobal, OpPrint, OpReturn>(code));
+  }
+
+  SECTION("Unused pure expressions are removed")
+  {
+    code.add_opcode(OpConstant{index});
+    code.add_opcode(OpConstant{index});
+    code.add_opcode(OpEqual{});
+    code.add_opcode(OpPop<1>{});
+    code.add_opcode(OpReturn{});
+    peephole(code);
+
+    REQUIRE(has_opcodes<OpReturn>(code));
+  }
+
+  SECTION("Pops are merged")
+  {
+    code.add_opcode(OpGetGlobalVar{detail::GlobalVariableIndex{0}});
+    code.add_opcode(OpGetGlobalVar{detail::GlobalVariableIndex{0}});
+    code.add_opcode(OpPop<1>{});
+    code.add_opcode(OpPop<1>{});
+    code.add_opcode(OpReturn{});
+    peephole(code);
+
+    REQUIRE(has_opcodes<OpGetGlobalVar, OpGetGlobalVar, OpPop<2>, OpReturn>(code));
+  }
+}
+
+TEST_CASE("Opcode profile", "[peephole]")
+{
+  auto code = Code{};
+  code.add_opcode(OpNil{});
+  code.add_opcode(OpNot{});
+  code.add_opcode(OpNot{});
+  code.add_opcode(OpPrint{});
+
+  auto profile = OpcodeProfile{};
+  profile.record(code);
+
+  REQUIRE(profile.bigrams().size() == 3);
+  REQUIRE(profile.bigrams().at({opcode_v<OpNot>, opcode_v<OpNot>}) == 1);
+  REQUIRE(profile.trigrams().size() == 2);
+  REQUIRE(profile.trigrams().at({opcode_v<OpNil>, opcode_v<OpNot>, opcode_v<OpNot>}) == 1);
+}
+
+// NOLINTEND(readability-magic-numbers)
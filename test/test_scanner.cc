@@ -0,0 +1,221 @@
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <random>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "clox/compile.hh"
+#include "clox/detail/scan.hh"
+#include "clox/scanner.hh"
+
+using namespace clox;
+
+// NOLINTBEGIN(readability-magic-numbers)
+
+namespace /* anonymous */ {
+
+constexpr auto program = std::string_view{R"(// A comment
+var greeting = "hello,
+world";
+var x = 12.5 * (3 - 1) / 4;
+if (x >= 2 and x != 3) print greeting; // Another comment
+print x <= 1 or !true;
+"unterminated)"};
+
+// Read `source` `chunk_size` bytes at a time.
+SourceReader
+reader(std::string_view source, std::size_t chunk_size)
+{
+  return [source, chunk_size](std::span<char> buffer) mutable
+  {
+    const auto size = std::min({source.size(), buffer.size(), chunk_size});
+    std::copy_n(source.begin(), size, buffer.begin());
+    source.remove_prefix(size);
+    return size;
+  };
+}
+
+} // namespace
+
+TEST_CASE("Keywords", "[scanner]")
+{
+  auto scanner = Scanner{"for fun false fu forward this true t while"};
+  for (const auto expected : {TokenType::for_,
+                              TokenType::fun,
+                              TokenType::false_,
+                              TokenType::identifier,
+                              TokenType::identifier,
+                              TokenType::this_,
+                              TokenType::true_,
+                              TokenType::identifier,
+                              TokenType::while_,
+                              TokenType::eof})
+  {
+    REQUIRE(scanner.next_token().type == expected);
+  }
+}
+
+TEST_CASE("Runs of characters", "[scanner]")
+{
+  // Cover whole blocks, partial blocks and characters above 127.
+  auto generator = std::mt19937{42};
+  auto character = std::uniform_int_distribution<int>{0, 255};
+  for (auto size = std::size_t{0}; size < 100; ++size)
+  {
+    auto str = std::string(size, ' ');
+    for (auto& c : str)
+    {
+      // Mostly long runs, sometimes interrupted.
+      c = character(generator) < 32 ? static_cast<char>(character(generator)) : 'a';
+    }
+    const auto* first = str.data();
+    const auto* last = str.data() + str.size();
+
+    const auto is_identifier_character = [](char c)
+    { return detail::is_alpha(c) or detail::is_digit(c); };
+    REQUIRE(detail::skip_identifier(first, last) ==
+            std::find_if_not(first, last, is_identifier_character));
+    std::ranges::replace(str, 'a', ' ');
+    REQUIRE(detail::skip_blanks(first, last) == std::find_if_not(first, last, detail::is_blank));
+    std::ranges::replace(str, ' ', '7');
+    REQUIRE(detail::skip_digits(first, last) == std::find_if_not(first, last, detail::is_digit));
+    REQUIRE(detail::count_newlines(first, last) ==
+            static_cast<std::size_t>(std::count(first, last, '\n')));
+  }
+}
+
+TEST_CASE("Streaming scanner", "[scanner]")
+{
+  for (const auto chunk_size : {std::size_t{1}, std::size_t{2}, std::size_t{7}, std::size_t{64}})
+  {
+    for (const auto read_size : {std::size_t{1}, std::size_t{3}, program.size()})
+    {
+      auto whole = Scanner{program};
+      auto streamed = Scanner{reader(program, read_size), chunk_size};
+      REQUIRE(whole.source() == program);
+      REQUIRE_FALSE(streamed.source().has_value());
+
+      // The previous token must still be valid once the next one has been scanned.
+      auto previous = Token{};
+      auto expected_previous = Token{};
+      while (true)
+      {
+        const auto expected = whole.next_token();
+        const auto token = streamed.next_token();
+        REQUIRE(token.type == expected.type);
+        REQUIRE(token.token == expected.token);
+        REQUIRE(token.offset == expected.offset);
+        REQUIRE(previous.token == expected_previous.token);
+        if (token.type == TokenType::eof)
+        {
+          break;
+        }
+        previous = token;
+        expected_previous = expected;
+      }
+    }
+  }
+}
+
+TEST_CASE("Streaming scanner drops skipped characters", "[scanner]")
+{
+  // A comment and a run of blanks much longer than a chunk.
+  const auto source = "// " + std::string(10'000, 'c') + "\n" + std::string(10'000, ' ') + "x";
+
+  auto largest_read = std::size_t{0};
+  auto read = reader(source, 16);
+  auto scanner = Scanner{[&](std::span<char> buffer)
+                         {
+                           largest_read = std::max(largest_read, buffer.size());
+                           return read(buffer);
+                         },
+                         16};
+
+  const auto token = scanner.next_token();
+  REQUIRE(token.type == TokenType::identifier);
+  REQUIRE(token.offset == source.size() - 1);
+  REQUIRE(scanner.next_token().type == TokenType::eof);
+  // Buffers grow with the token being scanned, but not with what is skipped before it.
+  REQUIRE(largest_read == 16);
+}
+
+TEST_CASE("Streamed source larger than 4 GiB", "[scanner]")
+{
+  // Blanks up to past the limit, then a token whose offset wouldn't fit.
+  auto remaining = max_source_offset + 2;
+  auto scanner = Scanner{[&](std::span<char> buffer)
+                         {
+                           const auto size = std::min(buffer.size(), remaining);
+                           std::fill_n(buffer.begin(), size, remaining == size ? 'x' : ' ');
+                           remaining -= size;
+                           return size;
+                         },
+                         1024 * 1024};
+
+  const auto error = scanner.next_token();
+  REQUIRE(error.type == TokenType::error);
+  REQUIRE(error.token == "Source larger than 4 GiB");
+  REQUIRE(error.offset == max_source_offset);
+  REQUIRE(scanner.next_token().type == TokenType::eof);
+  REQUIRE(scanner.next_token().type == TokenType::eof);
+}
+
+TEST_CASE("Parallel scanner", "[scanner]")
+{
+  // Newlines in strings and comments, quotes in comments and comments in strings can't be split.
+  static constexpr auto source = std::string_view{R"(var a = "first
+// not a comment
+line"; // a comment with a " quote
+print a + "//"; print 1 /
+2;
+
+var b = 3;
+print "unterminated
+string)"};
+
+  for (const auto nb_threads : {std::size_t{2}, std::size_t{3}, std::size_t{8}, std::size_t{64}})
+  {
+    auto sequential = Scanner{source};
+    auto parallel = Scanner::parallel(source, nb_threads, 1);
+    auto rescanned = parallel.rescan();
+    REQUIRE(rescanned.has_value());
+    while (true)
+    {
+      const auto expected = sequential.next_token();
+      for (auto* scanner : {&parallel, &*rescanned})
+      {
+        const auto token = scanner->next_token();
+        REQUIRE(token.type == expected.type);
+        REQUIRE(token.token == expected.token);
+        REQUIRE(token.offset == expected.offset);
+      }
+      if (expected.type == TokenType::eof)
+      {
+        break;
+      }
+    }
+  }
+}
+
+TEST_CASE("Compile a streamed source", "[scanner]")
+{
+  // Without a first pass over the source, globals can't be found to be constant: these are not.
+  static constexpr auto source = R"(var a = 1; var b = "b"; a = a + 2; b = b + "c"; print a + b;)";
+
+  const auto compile = [](Scanner&& scanner)
+  {
+    auto result = Compile{std::move(scanner)}(std::make_shared<Memory>());
+    REQUIRE(static_cast<bool>(result));
+    const auto bytecode = result.value().code->bytecode();
+    return std::vector<std::uint8_t>(bytecode.begin(), bytecode.end());
+  };
+
+  REQUIRE(compile(Scanner{reader(source, 5), 4}) == compile(Scanner{source}));
+}
+
+// NOLINTEND(readability-magic-numbers)
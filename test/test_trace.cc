@@ -0,0 +1,156 @@
+#include <algorithm>
+#include <memory>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "clox/compile.hh"
+#include "clox/disassemble.hh"
+#include "clox/trace.hh"
+#include "clox/vm.hh"
+
+using namespace clox;
+
+// NOLINTBEGIN(readability-magic-numbers)
+
+namespace /* anonymous */ {
+
+// Instructions are executed in order, as there are no jumps.
+constexpr auto program = std::string_view{R"(var a = 1;
+var b = a + 2;
+a = b * a - 3;
+b = -a == 1;
+var c = "x" + "y";)"};
+
+// Scan `source` as if it were streamed, a few bytes at a time.
+Scanner
+streamed(std::string_view source)
+{
+  return Scanner{[source](std::span<char> buffer) mutable
+                 {
+                   const auto size = std::min({source.size(), buffer.size(), std::size_t{3}});
+                   std::copy_n(source.begin(), size, buffer.begin());
+                   source.remove_prefix(size);
+                   return size;
+                 },
+                 8};
+}
+
+// Run `chunk` with a tracer, and return the trace.
+std::string
+trace(Chunk chunk, Tracer::opt_streamed streamed)
+{
+  auto os = std::ostringstream{};
+  {
+    // A ring buffer smaller than the trace, so that the VM waits for the writer.
+    auto tracer = Tracer{os, streamed, 4};
+    auto vm = VM{};
+    vm.set_tracer(&tracer);
+    REQUIRE(vm(std::move(chunk)).status == VMResultStatus::ok);
+  }
+  return os.str();
+}
+
+} // namespace
+
+TEST_CASE("Binary trace", "[trace]")
+{
+  auto compiled = Compile{Scanner{program}}(std::make_shared<Memory>());
+  REQUIRE(static_cast<bool>(compiled));
+  auto chunk = std::move(compiled.value());
+  const auto code = chunk.code;
+  const auto memory = chunk.memory;
+
+  auto is = std::istringstream{trace(std::move(chunk), Tracer::opt_streamed::no)};
+  const auto recorded = read_trace(is);
+
+  const auto traced = Chunk{code, memory};
+  auto expected = std::string{};
+  auto nb_instructions = std::size_t{0};
+  for (auto it = code->cbegin(); it != code->cend(); it = Code::next(it))
+  {
+    expected += disassemble(it, traced) + '\n';
+    ++nb_instructions;
+  }
+
+  SECTION("Events")
+  {
+    const auto& events = recorded.events;
+    REQUIRE(recorded.streamed == Tracer::opt_streamed::no);
+    REQUIRE(events.size() == nb_instructions);
+    REQUIRE(events.front() == TraceEvent{0, 0, *code->cbegin()});
+    REQUIRE(events.back().offset == code->size() - 1);
+    REQUIRE(events.back().stack_depth == 0);
+  }
+
+  SECTION("Decoded as disassembly")
+  {
+    auto decoded = std::ostringstream{};
+    decode_trace(recorded, traced, decoded);
+    REQUIRE(decoded.str() == expected);
+  }
+
+  SECTION("Decoded with an edited script")
+  {
+    // The same bytecode, with another constant.
+    auto edited = std::string{program};
+    edited.replace(edited.find("a + 2"), 5, "a + 5");
+    auto other = Compile{Scanner{edited}}(std::make_shared<Memory>());
+    REQUIRE(static_cast<bool>(other));
+    REQUIRE(std::ranges::equal(other.value().code->bytecode(), code->bytecode()));
+    auto decoded = std::ostringstream{};
+    REQUIRE_THROWS_AS(decode_trace(recorded, other.value(), decoded), std::runtime_error);
+  }
+
+  SECTION("Tracer of another chunk")
+  {
+    auto tracer_os = std::ostringstream{};
+    auto tracer = Tracer{tracer_os};
+    tracer.start(*code);
+    auto other = Compile{Scanner{"print 1;"}}(std::make_shared<Memory>());
+    REQUIRE(static_cast<bool>(other));
+    REQUIRE_THROWS_AS(tracer.start(*other.value().code), std::logic_error);
+  }
+}
+
+TEST_CASE("Binary trace of a streamed source", "[trace]")
+{
+  // The compiler doesn't replace `a` by its constant value when the source is streamed.
+  static constexpr auto constant_global = std::string_view{"var a = 1;\nvar b = a + 2;"};
+  auto compiled = Compile{streamed(constant_global)}(std::make_shared<Memory>());
+  REQUIRE(static_cast<bool>(compiled));
+  const auto code = compiled.value().code;
+  auto is = std::istringstream{trace(std::move(compiled.value()), Tracer::opt_streamed::yes)};
+  const auto recorded = read_trace(is);
+  REQUIRE(recorded.streamed == Tracer::opt_streamed::yes);
+
+  auto decoded = std::ostringstream{};
+  SECTION("Compiled again the same way")
+  {
+    auto again = Compile{streamed(constant_global)}(std::make_shared<Memory>());
+    REQUIRE(static_cast<bool>(again));
+    decode_trace(recorded, again.value(), decoded);
+    REQUIRE(not decoded.str().empty());
+  }
+
+  SECTION("Compiled from the whole source")
+  {
+    auto whole = Compile{Scanner{constant_global}}(std::make_shared<Memory>());
+    REQUIRE(static_cast<bool>(whole));
+    REQUIRE_FALSE(std::ranges::equal(whole.value().code->bytecode(), code->bytecode()));
+    REQUIRE_THROWS_AS(decode_trace(recorded, whole.value(), decoded), std::runtime_error);
+  }
+}
+
+TEST_CASE("Not a trace", "[trace]")
+{
+  auto is = std::istringstream{"This is not a trace, but some text"};
+  REQUIRE_THROWS_AS(read_trace(is), std::runtime_error);
+}
+
+// NOLINTEND(readability-magic-numbers)
@@ -1,5 +1,8 @@
+#include <limits>
+
 #include <catch2/catch_test_macros.hpp>
 
+#include "clox/memory.hh"
 #include "clox/value.hh"
 
 using namespace clox;
@@ -49,27 +52,74 @@ TEST_CASE("Double", "[Value]")
 
 TEST_CASE("String", "[Value]")
 {
+  auto memory = Memory{};
+
   SECTION("Creation")
   {
-    auto obj = std::make_unique<clox::ObjString>("foo");
-    const auto v = Value{obj.get()};
+    const auto v = Value{memory.make_string("foo")};
 
     REQUIRE(v.is<const clox::ObjString*>());
     REQUIRE(not v.is<bool>());
-    REQUIRE(v.as<const clox::ObjString*>()->str == "foo");
+    REQUIRE(v.as<const clox::ObjString*>()->str() == "foo");
   }
   SECTION("Equality", "[value]")
   {
-    auto obj0 = std::make_unique<clox::ObjString>("foo");
-    const auto v0 = Value{obj0.get()};
-    auto obj1 = std::make_unique<clox::ObjString>("foo");
-    const auto v1 = Value{obj1.get()};
-    auto obj2 = std::make_unique<clox::ObjString>("bar");
-    const auto v2 = Value{obj2.get()};
+    const auto v0 = Value{memory.make_string("foo")};
+    const auto v1 = Value{memory.make_string("foo")};
+    const auto v2 = Value{memory.make_string("bar")};
 
     REQUIRE(v0 == v1);
     REQUIRE(v1 == v0);
     REQUIRE(v0 != v2);
     REQUIRE(v1 != v2);
   }
+  SECTION("Ordering")
+  {
+    const auto v0 = Value{memory.make_string("ab")};
+    const auto v1 = Value{memory.make_string("b")};
+
+    REQUIRE(v0 < v1);
+    REQUIRE(not(v0 < v0));
+    REQUIRE(v0 <= v0);
+  }
+}
+
+TEST_CASE("Nil", "[Value]")
+{
+  SECTION("Creation")
+  {
+    const auto v = Value{};
+    REQUIRE(v.is<Nil>());
+    REQUIRE(not v.is<bool>());
+    REQUIRE(not v.is<double>());
+    REQUIRE(Value{Nil{}}.is<Nil>());
+  }
+
+  SECTION("Equality")
+  {
+    REQUIRE(Value{Nil{}} == Value{});
+    REQUIRE(Value{Nil{}} != Value{false});
+    REQUIRE(Value{Nil{}} != Value{0.0});
+  }
+}
+
+TEST_CASE("Type errors", "[Value]")
+{
+  const auto v = Value{true};
+  REQUIRE_THROWS_AS(v.as<double>(), BadValueAccess);
+  REQUIRE(v.type() == "boolean");
+}
+
+TEST_CASE("Special doubles", "[Value]")
+{
+  const auto nan = Value{std::numeric_limits<double>::quiet_NaN()};
+  REQUIRE(nan.is<double>());
+  REQUIRE(nan != nan);
+
+  const auto inf = Value{-std::numeric_limits<double>::infinity()};
+  REQUIRE(inf.is<double>());
+  REQUIRE(inf < Value{0.0});
+
+  REQUIRE(Value{-0.0}.is<double>());
+  REQUIRE(Value{-0.0} == Value{0.0});
 }
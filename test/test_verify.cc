@@ -0,0 +1,98 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "clox/compile.hh"
+#include "clox/verify.hh"
+
+using namespace clox;
+
+// NOLINTBEGIN(readability-magic-numbers)
+
+namespace /* anonymous */ {
+
+Chunk
+make_chunk()
+{
+  return Chunk{std::make_shared<Code>(), std::make_shared<Memory>()};
+}
+
+} // namespace
+
+TEST_CASE("Maximal stack depth", "[verify]")
+{
+  const auto program = std::string{"print 3 + 2 * (1 + 2);"};
+  auto result =
+    Compile{Scanner{program}, Compile::opt_optimize::no}(std::make_shared<Memory>());
+
+  REQUIRE(static_cast<bool>(result));
+  REQUIRE(result.value().code->max_stack_depth() == 4);
+}
+
+TEST_CASE("Valid code", "[verify]")
+{
+  auto chunk = make_chunk();
+  const auto index = chunk.code->add_constant(1.0);
+  chunk.code->add_opcode(OpConstant{index});
+  chunk.code->add_opcode(OpNil{});
+  chunk.code->add_opcode(OpPop<2>{});
+  chunk.code->add_opcode(OpReturn{});
+
+  const auto result = verify(chunk);
+  REQUIRE(static_cast<bool>(result));
+  REQUIRE(chunk.code->max_stack_depth() == 2);
+}
+
+TEST_CASE("Invalid code", "[verify]")
+{
+  auto chunk = make_chunk();
+
+  SECTION("Stack underflow")
+  {
+    chunk.code->add_opcode(OpNil{});
+    chunk.code->add_opcode(OpAdd{});
+    chunk.code->add_opcode(OpReturn{});
+  }
+
+  SECTION("Unbalanced stack")
+  {
+    chunk.code->add_opcode(OpNil{});
+    chunk.code->add_opcode(OpReturn{});
+  }
+
+  SECTION("Missing return")
+  {
+    chunk.code->add_opcode(OpNil{});
+    chunk.code->add_opcode(OpPrint{});
+  }
+
+  SECTION("Code after return")
+  {
+    chunk.code->add_opcode(OpReturn{});
+    chunk.code->add_opcode(OpReturn{});
+  }
+
+  SECTION("Unknown constant")
+  {
+    chunk.code->add_opcode(OpConstant{detail::ConstantIndex{0}});
+    chunk.code->add_opcode(OpPrint{});
+    chunk.code->add_opcode(OpReturn{});
+  }
+
+  SECTION("Unknown global variable")
+  {
+    chunk.code->add_opcode(OpGetGlobalVar{detail::GlobalVariableIndex{0}});
+    chunk.code->add_opcode(OpPrint{});
+    chunk.code->add_opcode(OpReturn{});
+  }
+
+  SECTION("Unchecked access to a global variable which may be undefined")
+  {
+    const auto index = chunk.memory->maybe_add_global_variable("a");
+    chunk.code->add_opcode(OpGetGlobalVarUnchecked{index});
+    chunk.code->add_opcode(OpDefineGlobalVar{index});
+    chunk.code->add_opcode(OpReturn{});
+  }
+
+  REQUIRE(not static_cast<bool>(verify(chunk)));
+}
+
+// NOLINTEND(readability-magic-numbers)
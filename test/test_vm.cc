@@ -0,0 +1,164 @@
+#include <array>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+#include <magic_enum.hpp>
+
+#include "clox/compile.hh"
+#include "clox/memory.hh"
+#include "clox/output.hh"
+#include "clox/vm.hh"
+
+using namespace clox;
+
+// NOLINTBEGIN(readability-magic-numbers)
+
+namespace /* anonymous */ {
+
+// Runtime errors are reported to std::cerr, which is redirected while this is alive.
+class CaptureErrors
+{
+public:
+  CaptureErrors()
+    : previous_{std::cerr.rdbuf(errors_.rdbuf())}
+  {}
+
+  ~CaptureErrors() { std::cerr.rdbuf(previous_); }
+  CaptureErrors(const CaptureErrors&) = delete;
+  CaptureErrors(CaptureErrors&&) = delete;
+  CaptureErrors& operator=(const CaptureErrors&) = delete;
+  CaptureErrors& operator=(CaptureErrors&&) = delete;
+
+  [[nodiscard]] std::string str() const { return errors_.str(); }
+
+private:
+  std::ostringstream errors_{};
+  std::streambuf* previous_;
+};
+
+struct Run
+{
+  VMResultStatus status;
+  std::string output;
+  std::string errors;
+};
+
+Run
+run(std::string_view program, VM::opt_dispatch dispatch)
+{
+  auto compiled = Compile{Scanner{program}}(std::make_shared<Memory>());
+  REQUIRE(static_cast<bool>(compiled));
+
+  auto os = std::ostringstream{};
+  auto output = Output{os, Output::opt_flush::exit};
+  auto vm = VM{VM::opt_disassemble::no, dispatch};
+  vm.set_output(output);
+  const auto errors = CaptureErrors{};
+  const auto status = vm(std::move(compiled.value())).status;
+  return {status, os.str(), errors.str()};
+}
+
+std::string
+read_sample(const std::filesystem::path& path)
+{
+  auto file = std::ifstream{path, std::ios::binary};
+  REQUIRE(file);
+  return {std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+}
+
+// Each stops at a runtime error.
+constexpr auto failing_programs = std::to_array<std::string_view>({
+  R"(print -"a";)",
+  R"(print 1 + nil;)",
+  R"(var a = "a"; print a * 2;)",
+  R"(print 1 < "a";)",
+  R"(print undefined;)",
+  R"(undefined = 1;)",
+  R"(print 1; print "a" - 1; print 2;)",
+});
+
+} // namespace
+
+TEST_CASE("Dispatch strategies", "[vm]")
+{
+  auto programs = std::vector<std::string>{};
+  for (const auto& entry : std::filesystem::directory_iterator{CLOX_SAMPLES_DIR})
+  {
+    // Not their caches.
+    if (entry.path().extension() == ".clox")
+    {
+      programs.push_back(read_sample(entry.path()));
+    }
+  }
+  REQUIRE_FALSE(programs.empty());
+  programs.insert(programs.end(), failing_programs.begin(), failing_programs.end());
+
+  for (const auto& program : programs)
+  {
+    CAPTURE(program);
+    const auto expected = run(program, VM::opt_dispatch::switch_loop);
+    for (const auto dispatch : magic_enum::enum_values<VM::opt_dispatch>())
+    {
+      if (not VM::supports(dispatch))
+      {
+        continue;
+      }
+      CAPTURE(magic_enum::enum_name(dispatch));
+      const auto result = run(program, dispatch);
+      REQUIRE(result.status == expected.status);
+      REQUIRE(result.output == expected.output);
+      REQUIRE(result.errors == expected.errors);
+    }
+  }
+}
+
+TEST_CASE("Runtime errors", "[vm]")
+{
+  struct Failure
+  {
+    std::string_view program;
+    std::string_view error;
+  };
+
+  static constexpr auto failures = std::to_array<Failure>({
+    {R"(print -"a";)", "line 1, column 7: Bad type access: expected number, got string\n"},
+    {R"(print 1 + nil;)", "line 1, column 9: Operands must be numbers or strings\n"},
+    {R"(var a = 1; print a + "b";)", "line 1, column 20: Operands must be numbers or strings\n"},
+    {R"(print undefined;)", "line 1, column 7: Undefined variable undefined\n"},
+    {R"(undefined = 1;)", "line 1, column 1: Undefined variable undefined\n"},
+  });
+
+  for (const auto& failure : failures)
+  {
+    CAPTURE(failure.program);
+    const auto result = run(failure.program, VM::default_dispatch);
+    REQUIRE(result.status == VMResultStatus::runtime_error);
+    REQUIRE(result.output.empty());
+    REQUIRE(result.errors == failure.error);
+  }
+}
+
+TEST_CASE("Output before a runtime error", "[vm]")
+{
+  auto compiled = Compile{Scanner{"print 1;\nprint \"a\" - 1;\nprint 2;"}}(
+    std::make_shared<Memory>());
+  REQUIRE(static_cast<bool>(compiled));
+
+  // Printed values and errors go to the same stream: values must be flushed first.
+  const auto errors = CaptureErrors{};
+  auto output = Output{std::cerr, Output::opt_flush::exit};
+  auto vm = VM{};
+  vm.set_output(output);
+  REQUIRE(vm(std::move(compiled.value())).status == VMResultStatus::runtime_error);
+  REQUIRE(errors.str() == "1\nline 2, column 11: Bad type access: expected number, got string\n");
+}
+
+// NOLINTEND(readability-magic-numbers)